@@ -1,14 +1,16 @@
 #pragma once
 #include "crow/query_string.h"
 #include "crow/http_parser_merged.h"
+#include "crow/arena.h"
 #include "crow/ci_map.h"
+#include "crow/known_headers.h"
 #include "crow/TinySHA1.hpp"
 #include "crow/settings.h"
 #include "crow/socket_adaptors.h"
 #include "crow/json.h"
 #include "crow/mustache.h"
 #include "crow/logging.h"
-#include "crow/dumb_timer_queue.h"
+#include "crow/timer_wheel.h"
 #include "crow/utility.h"
 #include "crow/common.h"
 #include "crow/http_request.h"
@@ -16,6 +18,8 @@
 #include "crow/parser.h"
 #include "crow/http_response.h"
 #include "crow/middleware.h"
+#include "crow/static_files.h"
+#include "crow/coroutine.h"
 #include "crow/routing.h"
 #include "crow/middleware_context.h"
 #include "crow/http_connection.h"
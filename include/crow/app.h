@@ -54,6 +54,27 @@ namespace crow
             router_.handle(req, res);
         }
 
+        BaseRule* find_body_rule(HTTPMethod method, string_view host, const std::string& url) const
+        {
+            return router_.find_body_rule(method, host, url);
+        }
+
+        // body size limit for requests to `rule' (null if unknown); 0 for none
+        std::size_t body_limit(const BaseRule* rule) const
+        {
+            if (rule && rule->get_max_body_size())
+                return rule->get_max_body_size();
+            return max_body_size_;
+        }
+
+#ifdef CROW_ENABLE_COMPRESSION
+        // null unless use_compression() was called
+        const compression_options* get_compression() const
+        {
+            return use_compression_ ? &compression_ : nullptr;
+        }
+#endif
+
         DynamicRule& route_dynamic(std::string&& rule)
         {
             return router_.new_rule_dynamic(std::move(rule));
@@ -66,6 +87,15 @@ namespace crow
             return router_.new_rule_tagged<Tag>(std::move(rule));
         }
 
+        // declares that every route is added before run() and never changes.
+        // the urls of routes without parameters are then matched through a
+        // perfect hash built at startup, without walking the trie.
+        self_t& fixed_routes(bool enabled = true)
+        {
+            router_.set_fixed_routes(enabled);
+            return *this;
+        }
+
         self_t& port(std::uint16_t port)
         {
             port_ = port;
@@ -91,6 +121,135 @@ namespace crow
             return *this;
         }
 
+        self_t& distribution(DistributionPolicy policy)
+        {
+            distribution_policy_ = policy;
+            return *this;
+        }
+
+        // keep up to `size' finished connections per worker thread and reuse
+        // them for new clients instead of allocating; 0 disables pooling.
+        self_t& connection_pool_size(std::size_t size)
+        {
+            connection_pool_size_ = size;
+            return *this;
+        }
+
+        // parse request headers and body into request::header_views and
+        // request::body_view instead of copying them into request::headers and
+        // request::body. the views are only valid until the response is completed.
+        // request::get_header_value() and request::body are empty in this mode;
+        // use get_header_view() and body_view.
+        self_t& request_views(bool enabled = true)
+        {
+            request_views_ = enabled;
+            return *this;
+        }
+
+        // requests with a larger body are answered with 413 and the connection
+        // is closed; routes may set their own limit. 0 (default) for no limit.
+        self_t& max_body_size(std::size_t size)
+        {
+            max_body_size_ = size;
+            return *this;
+        }
+
+#ifdef CROW_ENABLE_COMPRESSION
+        // compress response bodies of at least `min_size' bytes with gzip or
+        // deflate, if the client accepts either. streamed, file and shared
+        // bodies, bodies with a Content-Encoding and already compressed content
+        // types are sent as they are. routes may override the settings.
+        self_t& use_compression(int level = compression_options().level, std::size_t min_size = compression_options().min_size)
+        {
+            compression_.level = level;
+            compression_.min_size = min_size;
+            use_compression_ = true;
+            return *this;
+        }
+#endif
+
+        // at most `total' open connections, and `per_worker' on each worker
+        // thread; 0 for no limit. at the limit the server stops accepting,
+        // and new clients wait in the listen backlog until a connection closes.
+        self_t& max_connections(unsigned total, unsigned per_worker = 0)
+        {
+            max_connections_ = total;
+            max_connections_per_worker_ = per_worker;
+            return *this;
+        }
+
+        // keeps the rule and parameters of up to `entries' recent urls per
+        // worker thread, so requests for them skip the routing trie. it may be
+        // called while the server runs; each worker then frees its old cache
+        // when it makes a new one.
+        self_t& route_cache(std::size_t entries = 256)
+        {
+            router_.set_route_cache(entries);
+            return *this;
+        }
+
+        route_cache_stats get_route_cache_stats()
+        {
+            return router_.get_route_cache_stats();
+        }
+
+        // `threads' threads run the handlers of routes marked with offload(), so
+        // they can block without stalling the connections of a worker. when
+        // `max_queued' requests wait for a thread, more are answered with 503.
+        self_t& offload_threads(unsigned threads, std::size_t max_queued = 1024)
+        {
+            offload_threads_ = threads;
+            max_offload_queue_ = max_queued;
+            return *this;
+        }
+
+        detail::offload_pool* get_offload_pool()
+        {
+            return offload_pool_.get();
+        }
+
+        // a connection is closed if no request starts within `d' of it being
+        // accepted or of the previous response. default 5s, 0 for none.
+        template <typename Duration>
+        self_t& keep_alive_timeout(Duration d)
+        {
+            timeouts_.keep_alive = std::chrono::duration_cast<std::chrono::milliseconds>(d);
+            return *this;
+        }
+
+        // for the headers of a request to arrive once it started. default 5s.
+        template <typename Duration>
+        self_t& header_timeout(Duration d)
+        {
+            timeouts_.header = std::chrono::duration_cast<std::chrono::milliseconds>(d);
+            return *this;
+        }
+
+        // the longest pause while a request body is received. default 5s.
+        template <typename Duration>
+        self_t& body_timeout(Duration d)
+        {
+            timeouts_.body = std::chrono::duration_cast<std::chrono::milliseconds>(d);
+            return *this;
+        }
+
+        // for a handler to complete its response, or start streaming it; the
+        // connection is closed then. default 0, which waits indefinitely.
+        template <typename Duration>
+        self_t& handler_timeout(Duration d)
+        {
+            timeouts_.handler = std::chrono::duration_cast<std::chrono::milliseconds>(d);
+            return *this;
+        }
+
+        // every worker thread accepts on its own SO_REUSEPORT socket instead of
+        // sharing one acceptor thread.
+        self_t& reuse_port()
+        {
+            reuse_port_ = true;
+            return *this;
+        }
+
         void validate()
         {
             router_.validate();
@@ -106,26 +265,47 @@ namespace crow
         void run()
         {
             validate();
+            // a pool drained by stop() takes no more work
+            if (offload_threads_ && (!offload_pool_ || offload_pool_->drained()))
+            {
+                offload_pool_.reset(new detail::offload_pool(offload_threads_, max_offload_queue_));
+                router_.set_offload_pool(offload_pool_.get());
+            }
 #ifdef CROW_ENABLE_SSL
             if (use_ssl_)
             {
-                ssl_server_ = std::move(std::unique_ptr<ssl_server_t>(new ssl_server_t(this, bindaddr_, port_, &middlewares_, concurrency_, &ssl_context_)));
+                ssl_server_ = std::move(std::unique_ptr<ssl_server_t>(new ssl_server_t(this, bindaddr_, port_, &middlewares_, concurrency_, &ssl_context_, reuse_port_)));
                 ssl_server_->set_tick_function(tick_interval_, tick_function_);
+                ssl_server_->set_distribution_policy(distribution_policy_);
+                ssl_server_->set_connection_pool_size(connection_pool_size_);
+                ssl_server_->set_request_views(request_views_);
+                ssl_server_->set_timeouts(timeouts_);
+                ssl_server_->set_max_connections(max_connections_, max_connections_per_worker_);
                 notify_server_start();
                 ssl_server_->run();
             }
             else
 #endif
             {
-                server_ = std::move(std::unique_ptr<server_t>(new server_t(this, bindaddr_, port_, &middlewares_, concurrency_, nullptr)));
+                server_ = std::move(std::unique_ptr<server_t>(new server_t(this, bindaddr_, port_, &middlewares_, concurrency_, nullptr, reuse_port_)));
                 server_->set_tick_function(tick_interval_, tick_function_);
+                server_->set_distribution_policy(distribution_policy_);
+                server_->set_connection_pool_size(connection_pool_size_);
+                server_->set_request_views(request_views_);
+                server_->set_timeouts(timeouts_);
+                server_->set_max_connections(max_connections_, max_connections_per_worker_);
                 notify_server_start();
                 server_->run();
             }
         }
 
+        // offloaded handlers that are queued or running finish before the
+        // workers stop, so none runs after stop() returns; handlers offloaded
+        // meanwhile are answered with 503
         void stop()
         {
+            if (offload_pool_)
+                offload_pool_->drain();
 #ifdef CROW_ENABLE_SSL
             if (use_ssl_)
             {
@@ -138,6 +318,49 @@ namespace crow
             }
         }
 
+        // stops accepting, answers the requests that have begun with
+        // `Connection: close' and waits up to `timeout' for them to be written,
+        // then stops like stop(). `on_stopped' is called once it has.
+        template <typename Duration>
+        void stop_gracefully(Duration timeout, std::function<void()> on_stopped = nullptr)
+        {
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(timeout);
+#ifdef CROW_ENABLE_SSL
+            if (use_ssl_)
+            {
+                ssl_server_->stop_gracefully(ms, std::move(on_stopped));
+            }
+            else
+#endif
+            {
+                server_->stop_gracefully(ms, std::move(on_stopped));
+            }
+        }
+
+        // live connections per worker thread; empty before the server starts
+        std::vector<unsigned> connection_counts()
+        {
+#ifdef CROW_ENABLE_SSL
+            if (use_ssl_)
+            {
+                return ssl_server_ ? ssl_server_->connection_counts() : std::vector<unsigned>();
+            }
+#endif
+            return server_ ? server_->connection_counts() : std::vector<unsigned>();
+        }
+
+        // number of open connections
+        unsigned connection_count()
+        {
+#ifdef CROW_ENABLE_SSL
+            if (use_ssl_)
+            {
+                return ssl_server_ ? ssl_server_->connection_count() : 0;
+            }
+#endif
+            return server_ ? server_->connection_count() : 0;
+        }
+
         void debug_print()
         {
             CROW_LOG_DEBUG << "Routing:";
@@ -247,6 +470,18 @@ namespace crow
     private:
         uint16_t port_ = 80;
         uint16_t concurrency_ = 1;
+        bool reuse_port_ = false;
+        DistributionPolicy distribution_policy_ = DistributionPolicy::RoundRobin;
+        std::size_t connection_pool_size_ = 0;
+        bool request_views_ = false;
+        connection_timeouts timeouts_;
+        unsigned max_connections_ = 0;
+        unsigned max_connections_per_worker_ = 0;
+        std::size_t max_body_size_ = 0;
+#ifdef CROW_ENABLE_COMPRESSION
+        compression_options compression_;
+        bool use_compression_ = false;
+#endif
         std::string bindaddr_ = "0.0.0.0";
         Router router_;
 
@@ -260,6 +495,11 @@ namespace crow
 #endif
         std::unique_ptr<server_t> server_;
 
+        unsigned offload_threads_ = 0;
+        std::size_t max_offload_queue_ = 0;
+        // after router_: stopped before the rules its tasks refer to are gone
+        std::unique_ptr<detail::offload_pool> offload_pool_;
+
         bool server_started_{false};
         std::condition_variable cv_started_;
         std::mutex start_mutex_;
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+namespace crow
+{
+    namespace detail
+    {
+        // monotonic buffer for data that lives as long as one request.
+        // deallocation is a no-op; reset() rewinds to the first block in O(1)
+        // and keeps the blocks for the next request.
+        class arena
+        {
+        public:
+            static const std::size_t block_size = 4096;
+            // on reset, blocks beyond this size are returned to the system
+            static const std::size_t max_retained_size = 64*1024;
+
+            arena() noexcept
+            {
+            }
+
+            arena(const arena&) = delete;
+            arena& operator = (const arena&) = delete;
+
+            ~arena()
+            {
+                release(head_);
+            }
+
+            void* allocate(std::size_t size, std::size_t align)
+            {
+                while(true)
+                {
+                    if (current_)
+                    {
+                        std::uintptr_t base = reinterpret_cast<std::uintptr_t>(current_->data());
+                        std::uintptr_t p = (base + used_ + align - 1) & ~(std::uintptr_t)(align - 1);
+                        if (p + size <= base + current_->size)
+                        {
+                            used_ = p + size - base;
+                            return reinterpret_cast<void*>(p);
+                        }
+                        if (current_->next)
+                        {
+                            current_ = current_->next;
+                            used_ = 0;
+                            continue;
+                        }
+                    }
+
+                    std::size_t n = block_size;
+                    if (size + align > n)
+                        n = size + align;
+                    block* b = static_cast<block*>(::operator new(sizeof(block) + n));
+                    b->next = nullptr;
+                    b->size = n;
+                    if (current_)
+                        current_->next = b;
+                    else
+                        head_ = b;
+                    current_ = b;
+                    used_ = 0;
+                    total_size_ += n;
+                }
+            }
+
+            void reset() noexcept
+            {
+                if (total_size_ > max_retained_size && head_)
+                {
+                    release(head_->next);
+                    head_->next = nullptr;
+                    total_size_ = head_->size;
+                }
+                current_ = head_;
+                used_ = 0;
+            }
+
+            // bytes of memory owned by the arena
+            std::size_t capacity() const noexcept
+            {
+                return total_size_;
+            }
+
+        private:
+            struct block
+            {
+                block* next;
+                std::size_t size;
+
+                char* data()
+                {
+                    return reinterpret_cast<char*>(this + 1);
+                }
+            };
+
+            static void release(block* b) noexcept
+            {
+                while(b)
+                {
+                    block* next = b->next;
+                    ::operator delete(b);
+                    b = next;
+                }
+            }
+
+            block* head_{};
+            block* current_{};
+            std::size_t used_{};
+            std::size_t total_size_{};
+        };
+    }
+
+    // allocates from a detail::arena, or from the heap if constructed without one.
+    // copies of a container get a heap allocator, so copied data never outlives the arena.
+    template <typename T>
+    struct arena_allocator
+    {
+        using value_type = T;
+        using propagate_on_container_copy_assignment = std::false_type;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+
+        arena_allocator() noexcept
+        {
+        }
+
+        explicit arena_allocator(detail::arena* arena) noexcept
+            : arena_(arena)
+        {
+        }
+
+        template <typename U>
+        arena_allocator(const arena_allocator<U>& other) noexcept
+            : arena_(other.arena_)
+        {
+        }
+
+        T* allocate(std::size_t n)
+        {
+            if (arena_)
+                return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+
+        void deallocate(T* p, std::size_t) noexcept
+        {
+            if (!arena_)
+                ::operator delete(p);
+        }
+
+        arena_allocator select_on_container_copy_construction() const noexcept
+        {
+            return arena_allocator();
+        }
+
+        detail::arena* arena_{};
+    };
+
+    template <typename T, typename U>
+    inline bool operator == (const arena_allocator<T>& l, const arena_allocator<U>& r) noexcept
+    {
+        return l.arena_ == r.arena_;
+    }
+
+    template <typename T, typename U>
+    inline bool operator != (const arena_allocator<T>& l, const arena_allocator<U>& r) noexcept
+    {
+        return l.arena_ != r.arena_;
+    }
+}
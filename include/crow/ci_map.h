@@ -1,24 +1,75 @@
 #pragma once
 
-#include <boost/algorithm/string/predicate.hpp>
-#include <boost/functional/hash.hpp>
+#include <cstdint>
+#include <cstring>
+#include <string>
 #include <unordered_map>
 
+#include "crow/arena.h"
+#include "crow/common.h"
+
 namespace crow
 {
-    struct ci_hash
+    namespace detail
     {
-        size_t operator()(const std::string& key) const
+        // header names are ASCII, so case is folded without a locale, eight
+        // bytes at a time: 'A'..'Z' get 0x20 added, every other byte is kept.
+        inline std::uint64_t ascii_lower8(std::uint64_t x)
+        {
+            const std::uint64_t ones = 0x0101010101010101ull;
+            const std::uint64_t high = 0x8080808080808080ull;
+            std::uint64_t low7 = x & ~high;
+            // the high bit of each byte: >= 'A', > 'Z', and ASCII
+            std::uint64_t ge_a = low7 + ones * (0x80 - 'A');
+            std::uint64_t gt_z = low7 + ones * (0x7f - 'Z');
+            std::uint64_t upper = (ge_a ^ gt_z) & ~x & high;
+            return x | (upper >> 2);
+        }
+
+        // up to 8 bytes of `data', zero padded
+        inline std::uint64_t load8(const char* data, std::size_t size)
         {
-            std::size_t seed = 0;
-            std::locale locale;
+            std::uint64_t x = 0;
+            memcpy(&x, data, size < 8 ? size : 8);
+            return x;
+        }
+
+        inline std::size_t ci_hash(const char* data, std::size_t size)
+        {
+            std::uint64_t h = 0x9e3779b97f4a7c15ull ^ size;
+            for(std::size_t i = 0; i < size; i += 8)
+            {
+                h ^= ascii_lower8(load8(data + i, size - i));
+                h *= 0xff51afd7ed558ccdull;
+                h ^= h >> 32;
+            }
+            h *= 0xc4ceb9fe1a85ec53ull;
+            h ^= h >> 29;
+            return (std::size_t)h;
+        }
 
-            for(auto c : key)
+        inline bool ci_equal(const char* l, const char* r, std::size_t size)
+        {
+            for(std::size_t i = 0; i < size; i += 8)
             {
-                boost::hash_combine(seed, std::toupper(c, locale));
+                if (ascii_lower8(load8(l + i, size - i)) != ascii_lower8(load8(r + i, size - i)))
+                    return false;
             }
+            return true;
+        }
+    }
+
+    // whether two ASCII strings match, ignoring case
+    inline bool ci_equal(string_view l, string_view r)
+    {
+        return l.size() == r.size() && detail::ci_equal(l.data(), r.data(), l.size());
+    }
 
-            return seed;
+    struct ci_hash
+    {
+        size_t operator()(const std::string& key) const
+        {
+            return detail::ci_hash(key.data(), key.size());
         }
     };
 
@@ -26,9 +77,9 @@ namespace crow
     {
         bool operator()(const std::string& l, const std::string& r) const
         {
-            return boost::iequals(l, r);
+            return l.size() == r.size() && detail::ci_equal(l.data(), r.data(), l.size());
         }
     };
 
-    using ci_map = std::unordered_multimap<std::string, std::string, ci_hash, ci_key_eq>;
+    using ci_map = std::unordered_multimap<std::string, std::string, ci_hash, ci_key_eq, arena_allocator<std::pair<const std::string, std::string>>>;
 }
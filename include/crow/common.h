@@ -4,10 +4,13 @@
 #include <string>
 #include <stdexcept>
 #include <iostream>
+#include <boost/utility/string_ref.hpp>
 #include "crow/utility.h"
 
 namespace crow
 {
+    using string_view = boost::string_ref;
+
     enum class HTTPMethod
     {
 #ifndef DELETE
@@ -80,12 +83,65 @@ namespace crow
         MAX
     };
 
+    namespace detail
+    {
+        // a vector of at most N elements, stored inline
+        template <typename T, unsigned N>
+        class inline_vector
+        {
+        public:
+            void push_back(const T& value)
+            {
+                items_[size_++] = value;
+            }
+
+            void pop_back()
+            {
+                size_--;
+            }
+
+            const T& operator[](unsigned index) const
+            {
+                return items_[index];
+            }
+
+            unsigned size() const
+            {
+                return size_;
+            }
+
+            bool empty() const
+            {
+                return !size_;
+            }
+
+            const T* begin() const
+            {
+                return items_;
+            }
+
+            const T* end() const
+            {
+                return items_ + size_;
+            }
+
+        private:
+            T items_[N]{};
+            unsigned size_{};
+        };
+    }
+
+    // the parameters of a matched route, without heap allocations. string
+    // parameters point into the matched url.
     struct routing_params
     {
-        std::vector<int64_t> int_params;
-        std::vector<uint64_t> uint_params;
-        std::vector<double> double_params;
-        std::vector<std::string> string_params;
+        // the most parameters of one type a route may have
+        static const unsigned max_params = 8;
+
+        detail::inline_vector<int64_t, max_params> int_params;
+        detail::inline_vector<uint64_t, max_params> uint_params;
+        detail::inline_vector<double, max_params> double_params;
+        detail::inline_vector<string_view, max_params> string_params;
 
         void debug_print() const
         {
@@ -130,7 +186,7 @@ namespace crow
     template<>
     inline std::string routing_params::get<std::string>(unsigned index) const
     {
-        return string_params[index];
+        return string_params[index].to_string();
     }
 }
 
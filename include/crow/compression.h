@@ -0,0 +1,97 @@
+#pragma once
+
+#include "crow/settings.h"
+
+#ifdef CROW_ENABLE_COMPRESSION
+#include <string>
+#include <cstddef>
+#include <zlib.h>
+
+#include "crow/http_request.h"
+
+namespace crow
+{
+    struct compression_options
+    {
+        // 0 turns compression off; 1 (fastest) to 9 (smallest)
+        int level{6};
+        // smaller bodies are sent as they are
+        std::size_t min_size{1024};
+    };
+
+    namespace compression
+    {
+        enum algorithm
+        {
+            DEFLATE,
+            GZIP,
+        };
+
+        // true for content types that are compressed already
+        inline bool is_compressed_type(string_view type)
+        {
+            type = type.substr(0, type.find(';'));
+            while(!type.empty() && type.back() == ' ')
+                type.remove_suffix(1);
+            if (boost::istarts_with(type, "image/"))
+                return !boost::iequals(type, "image/svg+xml");
+            static const char* types[] = {
+                "application/zip", "application/gzip", "application/x-gzip",
+                "application/x-bzip2", "application/x-xz", "application/x-7z-compressed",
+                "application/x-rar-compressed", "application/pdf", "application/octet-stream",
+                "font/woff", "font/woff2",
+            };
+            for(auto t : types)
+            {
+                if (boost::iequals(type, t))
+                    return true;
+            }
+            return boost::istarts_with(type, "video/") || boost::istarts_with(type, "audio/");
+        }
+
+        // compresses `in' into `out'. every thread keeps one stream per algorithm
+        // and resets it between bodies instead of allocating a new one.
+        inline bool compress(const std::string& in, algorithm algo, int level, std::string& out)
+        {
+            struct stream
+            {
+                z_stream z{};
+                bool ok;
+                int level{Z_DEFAULT_COMPRESSION};
+
+                explicit stream(int window_bits)
+                {
+                    ok = deflateInit2(&z, level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+                }
+                ~stream()
+                {
+                    if (ok)
+                        deflateEnd(&z);
+                }
+            };
+            // window bits + 16 writes a gzip header and trailer
+            static thread_local stream gzip_stream(MAX_WBITS + 16), deflate_stream(MAX_WBITS);
+
+            stream& s = algo == GZIP ? gzip_stream : deflate_stream;
+            if (!s.ok || deflateReset(&s.z) != Z_OK)
+                return false;
+            if (s.level != level)
+            {
+                if (deflateParams(&s.z, level, Z_DEFAULT_STRATEGY) != Z_OK)
+                    return false;
+                s.level = level;
+            }
+
+            out.resize(deflateBound(&s.z, in.size()));
+            s.z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+            s.z.avail_in = in.size();
+            s.z.next_out = reinterpret_cast<Bytef*>(&out[0]);
+            s.z.avail_out = out.size();
+            if (deflate(&s.z, Z_FINISH) != Z_STREAM_END)
+                return false;
+            out.resize(s.z.total_out);
+            return true;
+        }
+    }
+}
+#endif
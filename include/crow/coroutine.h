@@ -0,0 +1,348 @@
+#pragma once
+
+#include "crow/settings.h"
+
+#ifdef CROW_CAN_USE_COROUTINES
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "crow/http_request.h"
+#include "crow/http_response.h"
+#include "crow/logging.h"
+#include "crow/offload_pool.h"
+
+namespace crow
+{
+    // the result of a coroutine. it starts when it is awaited; a handler
+    // returning task<response> is started by the router, and its response is
+    // sent when the coroutine returns:
+    //
+    //   CROW_ROUTE(app, "/")([](const crow::request& req) -> crow::task<crow::response>
+    //   {
+    //       co_await crow::sleep_for(req, std::chrono::milliseconds(10));
+    //       co_return "hello";
+    //   });
+    //
+    // the request stays valid until then. the coroutine runs on the
+    // connection's io_service; all the awaitables here resume it there.
+    template <typename T = response>
+    class task;
+
+    namespace detail
+    {
+        struct task_promise_base
+        {
+            std::coroutine_handle<> continuation;
+            std::exception_ptr exception;
+
+            struct final_awaiter
+            {
+                bool await_ready() noexcept { return false; }
+
+                // resumes the awaiting coroutine, if any, without growing the stack
+                template <typename Promise>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+                {
+                    auto c = h.promise().continuation;
+                    return c ? c : std::noop_coroutine();
+                }
+
+                void await_resume() noexcept {}
+            };
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            final_awaiter final_suspend() noexcept { return {}; }
+            void unhandled_exception() { exception = std::current_exception(); }
+        };
+
+        template <typename T>
+        struct task_promise : task_promise_base
+        {
+            std::optional<T> value;
+
+            task<T> get_return_object();
+
+            template <typename U>
+            void return_value(U&& v)
+            {
+                value.emplace(std::forward<U>(v));
+            }
+
+            T result()
+            {
+                if (exception)
+                    std::rethrow_exception(exception);
+                return std::move(*value);
+            }
+        };
+
+        template <>
+        struct task_promise<void> : task_promise_base
+        {
+            task<void> get_return_object();
+
+            void return_void() {}
+
+            void result()
+            {
+                if (exception)
+                    std::rethrow_exception(exception);
+            }
+        };
+    }
+
+    template <typename T>
+    class task
+    {
+    public:
+        using promise_type = detail::task_promise<T>;
+        using handle_t = std::coroutine_handle<promise_type>;
+
+        explicit task(handle_t h)
+            : h_(h)
+        {
+        }
+
+        task(task&& other) noexcept
+            : h_(std::exchange(other.h_, nullptr))
+        {
+        }
+
+        task& operator = (task&& other) noexcept
+        {
+            if (this != &other)
+            {
+                if (h_)
+                    h_.destroy();
+                h_ = std::exchange(other.h_, nullptr);
+            }
+            return *this;
+        }
+
+        ~task()
+        {
+            if (h_)
+                h_.destroy();
+        }
+
+        auto operator co_await() && noexcept
+        {
+            struct awaiter
+            {
+                handle_t h;
+
+                bool await_ready() noexcept { return false; }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+                {
+                    h.promise().continuation = awaiting;
+                    return h;
+                }
+
+                T await_resume()
+                {
+                    return h.promise().result();
+                }
+            };
+            return awaiter{h_};
+        }
+
+    private:
+        handle_t h_;
+    };
+
+    namespace detail
+    {
+        template <typename T>
+        inline task<T> task_promise<T>::get_return_object()
+        {
+            return task<T>(std::coroutine_handle<task_promise<T>>::from_promise(*this));
+        }
+
+        inline task<void> task_promise<void>::get_return_object()
+        {
+            return task<void>(std::coroutine_handle<task_promise<void>>::from_promise(*this));
+        }
+
+        // a coroutine nobody awaits; its frame is freed when it returns
+        struct detached_task
+        {
+            struct promise_type
+            {
+                detached_task get_return_object() { return {}; }
+                std::suspend_never initial_suspend() noexcept { return {}; }
+                std::suspend_never final_suspend() noexcept { return {}; }
+                void return_void() {}
+                void unhandled_exception() { std::terminate(); }
+            };
+        };
+
+        // runs a handler's task and completes `res' with its result
+        inline detached_task complete_with_task(task<response> t, response& res)
+        {
+            // any uncaught exceptions become 500s, as in Router::handle
+            try
+            {
+                res = co_await std::move(t);
+            }
+            catch(offload_queue_full&)
+            {
+                res = response(503);
+            }
+            catch(std::exception& e)
+            {
+                CROW_LOG_ERROR << "An uncaught exception occurred: " << e.what();
+                res = response(500);
+            }
+            catch(...)
+            {
+                CROW_LOG_ERROR << "An uncaught exception occurred. The type was unknown so no information was available.";
+                res = response(500);
+            }
+            res.end();
+        }
+
+        inline void complete_with(response& res, task<response> t)
+        {
+            complete_with_task(std::move(t), res);
+        }
+
+        // awaits an asio operation started by `initiate(handler)' whose handler
+        // takes (error_code, std::size_t)
+        template <typename Initiate>
+        struct io_awaiter
+        {
+            Initiate initiate;
+            boost::system::error_code* ec;
+            boost::system::error_code result_ec{};
+            std::size_t result{};
+
+            bool await_ready() { return false; }
+
+            void await_suspend(std::coroutine_handle<> h)
+            {
+                initiate([this, h](const boost::system::error_code& e, std::size_t n)
+                {
+                    result_ec = e;
+                    result = n;
+                    h.resume();
+                });
+            }
+
+            std::size_t await_resume()
+            {
+                if (ec)
+                    *ec = result_ec;
+                else if (result_ec)
+                    throw boost::system::system_error(result_ec);
+                return result;
+            }
+        };
+
+        template <typename Initiate>
+        io_awaiter<Initiate> make_io_awaiter(Initiate initiate, boost::system::error_code* ec)
+        {
+            return {std::move(initiate), ec};
+        }
+    }
+
+    // resumes after `d' on the request's io_service
+    template <typename Rep, typename Period>
+    auto sleep_for(const request& req, std::chrono::duration<Rep, Period> d)
+    {
+        struct awaiter
+        {
+            boost::asio::steady_timer timer;
+
+            bool await_ready() { return false; }
+
+            void await_suspend(std::coroutine_handle<> h)
+            {
+                timer.async_wait([h](const boost::system::error_code&){ h.resume(); });
+            }
+
+            void await_resume() {}
+        };
+        return awaiter{boost::asio::steady_timer(*req.io_service, d)};
+    }
+
+    // calls `f' on the app's offload pool and resumes with its result on the
+    // request's io_service. throws offload_queue_full (a 503 when it leaves
+    // the handler) if the pool is full. without a pool `f' is called inline.
+    template <typename Func>
+    auto offload(const request& req, Func f)
+    {
+        using result_t = decltype(f());
+        struct awaiter
+        {
+            const request& req;
+            Func f;
+            std::optional<typename std::conditional<std::is_void<result_t>::value, char, result_t>::type> result;
+            std::exception_ptr exception;
+
+            bool await_ready() { return !req.offload_pool; }
+
+            bool await_suspend(std::coroutine_handle<> h)
+            {
+                auto io_service = req.io_service;
+                bool posted = req.offload_pool->try_post([this, h, io_service]
+                {
+                    try
+                    {
+                        run();
+                    }
+                    catch(...)
+                    {
+                        exception = std::current_exception();
+                    }
+                    io_service->post([h]{ h.resume(); });
+                });
+                if (!posted)
+                    exception = std::make_exception_ptr(offload_queue_full());
+                return posted;
+            }
+
+            result_t await_resume()
+            {
+                if (!req.offload_pool)
+                    run();
+                if (exception)
+                    std::rethrow_exception(exception);
+                if constexpr (!std::is_void<result_t>::value)
+                    return std::move(*result);
+            }
+
+            void run()
+            {
+                if constexpr (std::is_void<result_t>::value)
+                    f();
+                else
+                    result.emplace(f());
+            }
+        };
+        return awaiter{req, std::move(f), std::nullopt, nullptr};
+    }
+
+    // reads from an asio stream, e.g. a socket to a backend made on
+    // req.io_service. throws boost::system::system_error unless `ec' is given.
+    template <typename AsyncReadStream, typename MutableBuffers>
+    auto async_read_some(AsyncReadStream& stream, const MutableBuffers& buffers, boost::system::error_code* ec = nullptr)
+    {
+        return detail::make_io_awaiter([&stream, buffers](auto handler){ stream.async_read_some(buffers, std::move(handler)); }, ec);
+    }
+
+    // writes all of `buffers' to an asio stream
+    template <typename AsyncWriteStream, typename ConstBuffers>
+    auto async_write(AsyncWriteStream& stream, const ConstBuffers& buffers, boost::system::error_code* ec = nullptr)
+    {
+        return detail::make_io_awaiter([&stream, buffers](auto handler){ boost::asio::async_write(stream, buffers, std::move(handler)); }, ec);
+    }
+}
+#endif
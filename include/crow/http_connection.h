@@ -4,7 +4,11 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/array.hpp>
 #include <atomic>
+#include <cerrno>
+#include <cstring>
 #include <chrono>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include "crow/http_parser_merged.h"
@@ -13,7 +17,7 @@
 #include "crow/http_response.h"
 #include "crow/logging.h"
 #include "crow/settings.h"
-#include "crow/dumb_timer_queue.h"
+#include "crow/timer_wheel.h"
 #include "crow/middleware_context.h"
 #include "crow/socket_adaptors.h"
 
@@ -173,32 +177,391 @@ namespace crow
             after_handler_call<CurrentMW, Context, parent_context_t>(std::get<N>(middlewares), req, res, ctx, static_cast<parent_context_t&>(ctx));
             after_handlers_call_helper<N-1, Context, Container>(middlewares, ctx, req, res);
         }
+
+        // reason phrase of each status code a response may have, nullptr for others
+        constexpr const char* status_reason(int code)
+        {
+            switch(code)
+            {
+                case 200: return "OK";
+                case 201: return "Created";
+                case 202: return "Accepted";
+                case 203: return "Non-Authoritative Information";
+                case 204: return "No Content";
+                case 205: return "Reset Content";
+                case 206: return "Partial Content";
+                case 207: return "Multi-Status";
+                case 208: return "Already Reported";
+                case 226: return "IM Used";
+
+                case 300: return "Multiple Choices";
+                case 301: return "Moved Permanently";
+                case 302: return "Moved Temporarily";
+                case 303: return "See Other";
+                case 304: return "Not Modified";
+                case 305: return "Use Proxy";
+                case 307: return "Temporary Redirect";
+                case 308: return "Permanent Redirect";
+
+                case 400: return "Bad Request";
+                case 401: return "Unauthorized";
+                case 402: return "Payment Required";
+                case 403: return "Forbidden";
+                case 404: return "Not Found";
+                case 405: return "Method Not Allowed";
+                case 406: return "Not Acceptable";
+                case 407: return "Proxy Authentication Required";
+                case 408: return "Request Timeout";
+                case 409: return "Conflict";
+                case 410: return "Gone";
+                case 411: return "Length Required";
+                case 412: return "Precondition Failed";
+                case 413: return "Payload Too Large";
+                case 414: return "URI Too Long";
+                case 415: return "Unsupported Media Type";
+                case 416: return "Range Not Satisfiable";
+                case 417: return "Expectation Failed";
+                case 418: return "I'm a teapot";
+                case 421: return "Misdirected Request";
+                case 422: return "Unprocessable Entity";
+                case 423: return "Locked";
+                case 424: return "Failed Dependency";
+                case 425: return "Too Early";
+                case 426: return "Upgrade Required";
+                case 428: return "Precondition Required";
+                case 429: return "Too Many Requests";
+                case 431: return "Request Header Fields Too Large";
+                case 451: return "Unavailable For Legal Reasons";
+
+                case 500: return "Internal Server Error";
+                case 501: return "Not Implemented";
+                case 502: return "Bad Gateway";
+                case 503: return "Service Unavailable";
+                case 504: return "Gateway Timeout";
+                case 505: return "HTTP Version Not Supported";
+                case 506: return "Variant Also Negotiates";
+                case 507: return "Insufficient Storage";
+                case 508: return "Loop Detected";
+                case 510: return "Not Extended";
+                case 511: return "Network Authentication Required";
+            }
+            return nullptr;
+        }
+
+        // "HTTP/1.1 <code> <reason>\r\n", or an empty string for unknown codes
+        inline const std::string& status_line(int code)
+        {
+            static const int first = 200, last = 599;
+            struct table
+            {
+                std::string lines[last - first + 1];
+
+                table()
+                {
+                    for(int code = first; code <= last; code++)
+                    {
+                        if (auto reason = status_reason(code))
+                            lines[code - first] = "HTTP/1.1 " + std::to_string(code) + ' ' + reason + "\r\n";
+                    }
+                }
+            };
+            static const table lines;
+            static const std::string unknown;
+            if (code < first || code > last)
+                return unknown;
+            return lines.lines[code - first];
+        }
+
+        // appends `n' in lowercase hex, as used for chunk sizes
+        inline void append_hex(std::string& out, std::size_t n)
+        {
+            char digits[16];
+            int i = sizeof(digits);
+            do
+            {
+                digits[--i] = "0123456789abcdef"[n % 16];
+                n /= 16;
+            } while(n);
+            out.append(digits + i, sizeof(digits) - i);
+        }
+
+        // appends the decimal digits of `n' without a temporary string
+        inline void append_number(std::string& out, std::size_t n)
+        {
+            char digits[20];
+            int i = sizeof(digits);
+            do
+            {
+                digits[--i] = '0' + n % 10;
+                n /= 10;
+            } while(n);
+            out.append(digits + i, sizeof(digits) - i);
+        }
+
+        // a buffer sequence over a vector's elements; unlike the vector itself,
+        // async_write can copy it without allocating
+        struct const_buffers_view
+        {
+            using value_type = boost::asio::const_buffer;
+            using const_iterator = const boost::asio::const_buffer*;
+
+            const_iterator begin() const
+            {
+                return begin_;
+            }
+
+            const_iterator end() const
+            {
+                return end_;
+            }
+
+            const_iterator begin_;
+            const_iterator end_;
+        };
+
+        // storage for one in-flight asio operation of a connection, so that the
+        // read and write loops don't allocate; falls back to the heap when busy.
+        class handler_memory
+        {
+        public:
+            void* allocate(std::size_t size)
+            {
+                if (!in_use_ && size <= sizeof(storage_))
+                {
+                    in_use_ = true;
+                    return &storage_;
+                }
+                return ::operator new(size);
+            }
+
+            void deallocate(void* p)
+            {
+                if (p == &storage_)
+                {
+                    in_use_ = false;
+                    return;
+                }
+                ::operator delete(p);
+            }
+
+        private:
+            typename std::aligned_storage<512>::type storage_;
+            bool in_use_{};
+        };
+
+        template <typename Handler>
+        struct custom_alloc_handler
+        {
+            handler_memory* memory;
+            Handler handler;
+
+            template <typename ... Args>
+            void operator()(Args&& ... args)
+            {
+                handler(std::forward<Args>(args)...);
+            }
+
+            friend void* asio_handler_allocate(std::size_t size, custom_alloc_handler* self)
+            {
+                return self->memory->allocate(size);
+            }
+
+            friend void asio_handler_deallocate(void* p, std::size_t, custom_alloc_handler* self)
+            {
+                self->memory->deallocate(p);
+            }
+        };
+
+        template <typename Handler>
+        inline custom_alloc_handler<Handler> make_custom_alloc_handler(handler_memory& memory, Handler h)
+        {
+            return {&memory, std::move(h)};
+        }
+
+        // per-worker free list of finished connections.
+        // reused by the next accept so that their buffers stay allocated.
+        template <typename T>
+        class connection_pool
+        {
+        public:
+            ~connection_pool()
+            {
+                for(auto p : free_)
+                    delete p;
+            }
+
+            void set_max_size(size_t max_size)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                max_size_ = max_size;
+            }
+
+            T* acquire()
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (free_.empty())
+                    return nullptr;
+                T* p = free_.back();
+                free_.pop_back();
+                return p;
+            }
+
+            // returns false if the pool is full; caller keeps ownership.
+            bool release(T* p)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (free_.size() >= max_size_)
+                    return false;
+                free_.push_back(p);
+                return true;
+            }
+
+        private:
+            std::mutex mutex_;
+            std::vector<T*> free_;
+            size_t max_size_{};
+        };
+
+        // the live connections of a worker, linked through the connections
+        // themselves. only used on the worker's thread.
+        template <typename T>
+        class connection_list
+        {
+        public:
+            void insert(T* p)
+            {
+                p->list_prev_ = nullptr;
+                p->list_next_ = head_;
+                if (head_)
+                    head_->list_prev_ = p;
+                head_ = p;
+            }
+
+            void erase(T* p)
+            {
+                if (p->list_prev_)
+                    p->list_prev_->list_next_ = p->list_next_;
+                else if (head_ == p)
+                    head_ = p->list_next_;
+                if (p->list_next_)
+                    p->list_next_->list_prev_ = p->list_prev_;
+                p->list_prev_ = p->list_next_ = nullptr;
+            }
+
+            // `f' may close the connection it is given
+            template <typename F>
+            void for_each(F f)
+            {
+                for(T* p = head_; p; )
+                {
+                    T* next = p->list_next_;
+                    f(p);
+                    p = next;
+                }
+            }
+
+        private:
+            T* head_{};
+        };
     }
 
+    // how long a connection may wait for each step of a request; 0 disables a timeout
+    struct connection_timeouts
+    {
+        // for the first byte of a request, after the previous response
+        std::chrono::milliseconds keep_alive{5000};
+        // for the headers of a request, once it started arriving
+        std::chrono::milliseconds header{5000};
+        // between two reads of a request body
+        std::chrono::milliseconds body{5000};
+        // for a handler to complete or start streaming its response
+        std::chrono::milliseconds handler{0};
+    };
+
 #ifdef CROW_ENABLE_DEBUG
     static std::atomic<int> connectionCount;
 #endif
     template <typename Adaptor, typename Handler, typename ... Middlewares>
     class Connection
     {
+        // a parsed request and its response. pipelined requests are handled
+        // as they arrive, but responses are written in request order.
+        struct pipeline_entry
+        {
+            // header nodes of req and res
+            detail::arena arena;
+            request req;
+            response res;
+            detail::context<Middlewares...> ctx;
+
+            bool need_to_call_after_handlers{};
+            bool add_keep_alive{};
+            bool http_1_1{};
+            // the response is serialized to `header' and `body' and waits for its turn
+            bool ready{};
+            // streamed responses: `header' is serialized, and `body' holds the
+            // part of res.body that is being written
+            bool header_serialized{};
+            bool header_sent{};
+            bool chunked{};
+
+            std::string header;
+            std::string body;
+            std::string chunk_size;
+
+            // receives the body as it arrives, for routes with a body reader
+            std::function<void(string_view)> body_reader;
+        };
+
+        // what the running timer waits for
+        enum class wait_state
+        {
+            none,
+            request,
+            header,
+            body,
+            handler,
+            linger,
+        };
+
     public:
+        // requests parsed ahead of their responses; parsing waits beyond that
+        static const size_t max_pipeline_depth = 16;
+        // file bodies up to this size are copied instead of sent from the file
+        static const size_t max_copied_file_size = 16*1024;
+        // after a request is rejected, at most this much of the rest of it is
+        // read and thrown away before the connection closes (see lingering_close)
+        static const size_t max_linger_size = 1024*1024;
+
         Connection(
             boost::asio::io_service& io_service, 
             Handler* handler, 
             const std::string& server_name,
             std::tuple<Middlewares...>* middlewares,
-            std::function<std::string()>& get_cached_date_str_f,
-            detail::dumb_timer_queue& timer_queue,
-            typename Adaptor::context* adaptor_ctx_
+            std::function<const std::string&()>& get_cached_date_str_f,
+            detail::timer_wheel& timers,
+            std::atomic<unsigned>& connection_count,
+            std::function<void()>& connection_closed,
+            detail::connection_pool<Connection>& connection_pool,
+            detail::connection_list<Connection>& connection_list,
+            typename Adaptor::context* adaptor_ctx
             ) 
-            : adaptor_(io_service, adaptor_ctx_), 
+            : io_service_(io_service),
+            adaptor_ctx_(adaptor_ctx),
+            adaptor_(io_service, adaptor_ctx), 
             handler_(handler), 
             parser_(this), 
             server_name_(server_name),
             middlewares_(middlewares),
             get_cached_date_str(get_cached_date_str_f),
-            timer_queue(timer_queue)
+            timers_(timers),
+            connection_count_(connection_count),
+            connection_closed_(connection_closed),
+            connection_pool_(connection_pool),
+            connection_list_(connection_list)
         {
+            next_entry_ = acquire_entry();
+            parser_.use_arena(&next_entry_->arena);
 #ifdef CROW_ENABLE_DEBUG
             connectionCount ++;
             CROW_LOG_DEBUG << "Connection open, total " << connectionCount << ", " << this;
@@ -207,7 +570,6 @@ namespace crow
         
         ~Connection()
         {
-            res.complete_request_handler_ = nullptr;
             cancel_deadline_timer();
 #ifdef CROW_ENABLE_DEBUG
             connectionCount --;
@@ -220,12 +582,54 @@ namespace crow
             return adaptor_.raw_socket();
         }
 
-        void start()
+        void set_request_views(bool enabled)
         {
+            parser_.use_views = enabled;
+        }
+
+        void set_timeouts(const connection_timeouts& timeouts)
+        {
+            timeouts_ = timeouts;
+        }
+
+        // the server is stopping: requests that have begun are answered with
+        // `Connection: close', and the connection closes once they are written
+        void drain()
+        {
+            draining_ = true;
+            close_connection_ = true;
+            if (pipeline_.empty() && !pending_handlers_ && !is_writing && !parser_.in_message())
+            {
+                // only waiting for a request
+                cancel_deadline_timer();
+                close_socket();
+            }
+        }
+
+        // closes the socket without waiting for responses
+        void close()
+        {
+            cancel_deadline_timer();
+            close_socket();
+        }
+
+        // `server_draining': the server began to stop after the connection
+        // was accepted, too late to find it in the list and drain it
+        void start(bool server_draining = false)
+        {
+            connection_list_.insert(this);
+            if (server_draining)
+            {
+                // no request has begun; it closes as idle connections do
+                close_socket();
+                check_destroy();
+                return;
+            }
+            socket_open_ = true;
             adaptor_.start([this](const boost::system::error_code& ec) {
                 if (!ec)
                 {
-                    start_deadline();
+                    start_read_deadline();
 
                     do_read();
                 }
@@ -238,32 +642,64 @@ namespace crow
 
         void handle_header()
         {
+            // routes that limit or read bodies themselves are matched before the body arrives
+            auto rule = handler_->find_body_rule((HTTPMethod)parser_.method, parser_.get_header_view(known_header::host), parser_.url);
+            parser_.max_body_size = handler_->body_limit(rule);
+            if (parser_.max_body_size && !(parser_.flags & F_CHUNKED) &&
+                parser_.content_length != CROW_ULLONG_MAX && parser_.content_length > parser_.max_body_size)
+            {
+                reject_request(413);
+                return;
+            }
+
             // HTTP 1.1 Expect: 100-continue
-            if (parser_.check_version(1, 1) && parser_.headers.count("expect") && get_header_value(parser_.headers, "expect") == "100-continue")
+            if (parser_.check_version(1, 1) && parser_.get_header_view(known_header::expect) == "100-continue")
             {
-                buffers_.clear();
-                static std::string expect_100_continue = "HTTP/1.1 100 Continue\r\n\r\n";
-                buffers_.emplace_back(expect_100_continue.data(), expect_100_continue.size());
+                need_to_send_continue_ = true;
                 do_write();
             }
+
+            if (rule && rule->has_body_reader())
+            {
+                parser_.move_headers_to_request(next_entry_->req);
+                next_entry_->body_reader = rule->make_body_reader(next_entry_->req);
+                parser_.stream_body = true;
+            }
+        }
+
+        void handle_body(const char* data, size_t size)
+        {
+            next_entry_->body_reader(string_view(data, size));
+        }
+
+        // a body without Content-Length grew beyond the limit
+        void handle_body_too_large()
+        {
+            reject_request(413);
         }
 
         void handle()
         {
             cancel_deadline_timer();
             bool is_invalid_request = false;
-            add_keep_alive_ = false;
 
-            req_ = std::move(parser_.to_request());
-            request& req = req_;
+            pipeline_entry& entry = *next_entry_;
+            pipeline_.push_back(next_entry_);
+            // a streamed body's request got its headers before the body
+            if (!parser_.stream_body)
+                parser_.move_to_request(entry.req);
+            request& req = entry.req;
+            response& res = entry.res;
+            // response headers share the arena of this request's headers
+            res.headers = ci_map(req.headers.get_allocator());
 
             if (parser_.check_version(1, 0))
             {
                 // HTTP/1.0
-                if (req.headers.count("connection"))
+                if (req.has_header(known_header::connection))
                 {
-                    if (boost::iequals(req.get_header_value("connection"),"Keep-Alive"))
-                        add_keep_alive_ = true;
+                    if (ci_equal(req.get_header_view(known_header::connection),"Keep-Alive"))
+                        entry.add_keep_alive = true;
                 }
                 else
                     close_connection_ = true;
@@ -271,21 +707,23 @@ namespace crow
             else if (parser_.check_version(1, 1))
             {
                 // HTTP/1.1
-                if (req.headers.count("connection"))
+                entry.http_1_1 = true;
+                if (req.has_header(known_header::connection))
                 {
-                    if (req.get_header_value("connection") == "close")
+                    string_view connection = req.get_header_view(known_header::connection);
+                    if (connection == "close")
                         close_connection_ = true;
-                    else if (boost::iequals(req.get_header_value("connection"),"Keep-Alive"))
-                        add_keep_alive_ = true;
+                    else if (ci_equal(connection,"Keep-Alive"))
+                        entry.add_keep_alive = true;
                 }
-                if (!req.headers.count("host"))
+                if (!req.has_header(known_header::host))
                 {
                     is_invalid_request = true;
                     res = response(400);
                 }
 				if (parser_.is_upgrade())
 				{
-					if (req.get_header_value("upgrade") == "h2c")
+					if (req.get_header_view(known_header::upgrade) == "h2c")
 					{
 						// TODO HTTP/2
                         // currently, ignore upgrade header
@@ -293,310 +731,811 @@ namespace crow
                     else
                     {
                         close_connection_ = true;
+                        prepare_next_entry();
+                        socket_open_ = false;
                         handler_->handle_upgrade(req, res, std::move(adaptor_));
                         return;
                     }
 				}
             }
 
+            prepare_next_entry();
+
             CROW_LOG_INFO << "Request: " << boost::lexical_cast<std::string>(adaptor_.remote_endpoint()) << " " << this << " HTTP/" << parser_.http_major << "." << parser_.http_minor << ' '
              << method_name(req.method) << " " << req.url;
 
 
-            need_to_call_after_handlers_ = false;
+            entry.need_to_call_after_handlers = false;
             if (!is_invalid_request)
             {
                 res.complete_request_handler_ = []{};
-                res.is_alive_helper_ = [this]()->bool{ return adaptor_.is_open(); };
+                res.is_alive_helper_ = [this]()->bool{ return socket_open_; };
 
-                ctx_ = detail::context<Middlewares...>();
-                req.middleware_context = (void*)&ctx_;
+                entry.ctx = detail::context<Middlewares...>();
+                req.middleware_context = (void*)&entry.ctx;
                 req.io_service = &adaptor_.get_io_service();
-                detail::middleware_call_helper<0, decltype(ctx_), decltype(*middlewares_), Middlewares...>(*middlewares_, req, res, ctx_);
+                req.offload_pool = handler_->get_offload_pool();
+                detail::middleware_call_helper<0, decltype(entry.ctx), decltype(*middlewares_), Middlewares...>(*middlewares_, req, res, entry.ctx);
+                // middlewares may have changed req.headers directly; routing
+                // and the handler look at the slots
+                if (sizeof...(Middlewares))
+                    req.index_headers();
 
                 if (!res.completed_)
                 {
-                    res.complete_request_handler_ = [this]{ this->complete_request(); };
-                    need_to_call_after_handlers_ = true;
+                    pipeline_entry* p = &entry;
+                    res.complete_request_handler_ = [this, p]{ this->complete_request(*p); };
+                    res.flush_handler_ = [this, p]{ this->flush_stream(*p); };
+                    entry.need_to_call_after_handlers = true;
+                    pending_handlers_++;
                     handler_->handle(req, res);
-                    if (add_keep_alive_)
-                        res.set_header("connection", "Keep-Alive");
+                    // (res may be completed on another thread by now)
+                    if (entry.need_to_call_after_handlers && adaptor_.is_open())
+                        start_deadline(wait_state::handler);
                 }
                 else
                 {
-                    complete_request();
+                    complete_request(entry);
                 }
             }
             else
             {
-                complete_request();
+                complete_request(entry);
             }
         }
 
-        void complete_request()
+        void complete_request(pipeline_entry& entry)
         {
-            CROW_LOG_INFO << "Response: " << this << ' ' << req_.raw_url << ' ' << res.code << ' ' << close_connection_;
+            request& req = entry.req;
+            response& res = entry.res;
+            CROW_LOG_INFO << "Response: " << this << ' ' << req.raw_url << ' ' << res.code << ' ' << close_connection_;
 
-            if (need_to_call_after_handlers_)
+            if (entry.need_to_call_after_handlers)
             {
-                need_to_call_after_handlers_ = false;
+                entry.need_to_call_after_handlers = false;
+                pending_handlers_--;
 
                 // call all after_handler of middlewares
                 detail::after_handlers_call_helper<
                     ((int)sizeof...(Middlewares)-1),
-                    decltype(ctx_),
+                    decltype(entry.ctx),
                     decltype(*middlewares_)> 
-                (*middlewares_, ctx_, req_, res);
+                (*middlewares_, entry.ctx, req, res);
             }
 
             //auto self = this->shared_from_this();
             res.complete_request_handler_ = nullptr;
+            if (!pending_handlers_ && wait_state_ == wait_state::handler)
+                cancel_deadline_timer();
             
             if (!adaptor_.is_open())
             {
-                //CROW_LOG_DEBUG << this << " delete (socket is closed) " << is_reading << ' ' << is_writing;
-                //delete this;
+                // closed (e.g. timed out) while handlers were running; once the
+                // last one is done nothing can be written anymore
+                if (!pending_handlers_ && !is_writing && !continue_posted_)
+                {
+                    stop_waiting_to_read();
+                    continue_posted_ = true;
+                    io_service_.post([this]{ continue_posted_ = false; check_destroy(); });
+                }
                 return;
             }
 
-            static std::unordered_map<int, std::string> statusCodes = {
-                {200, "HTTP/1.1 200 OK\r\n"},
-                {201, "HTTP/1.1 201 Created\r\n"},
-                {202, "HTTP/1.1 202 Accepted\r\n"},
-                {204, "HTTP/1.1 204 No Content\r\n"},
-
-                {300, "HTTP/1.1 300 Multiple Choices\r\n"},
-                {301, "HTTP/1.1 301 Moved Permanently\r\n"},
-                {302, "HTTP/1.1 302 Moved Temporarily\r\n"},
-                {304, "HTTP/1.1 304 Not Modified\r\n"},
-
-                {400, "HTTP/1.1 400 Bad Request\r\n"},
-                {401, "HTTP/1.1 401 Unauthorized\r\n"},
-                {403, "HTTP/1.1 403 Forbidden\r\n"},
-                {404, "HTTP/1.1 404 Not Found\r\n"},
-                {413, "HTTP/1.1 413 Payload Too Large\r\n"},
-                {422, "HTTP/1.1 422 Unprocessable Entity\r\n"},
-                {429, "HTTP/1.1 429 Too Many Requests\r\n"},
-
-                {500, "HTTP/1.1 500 Internal Server Error\r\n"},
-                {501, "HTTP/1.1 501 Not Implemented\r\n"},
-                {502, "HTTP/1.1 502 Bad Gateway\r\n"},
-                {503, "HTTP/1.1 503 Service Unavailable\r\n"},
-            };
+            if (res.streaming_)
+            {
+                // the rest of res.body goes out with the last chunk
+                res.flush_handler_ = nullptr;
+                serialize_header(entry);
+            }
+            else
+            {
+                if (res.body_size() == 0 && res.json_value.t() == json::type::Object)
+                {
+                    res.body = json::dump(res.json_value);
+                }
+#ifdef CROW_ENABLE_COMPRESSION
+                compress_body(entry);
+#endif
+                serialize_header(entry);
+                entry.body.swap(res.body);
+                if (res.has_file() && res.file_.size <= max_copied_file_size)
+                    copy_file_body(entry);
+            }
+            entry.ready = true;
 
-            static std::string seperator = ": ";
-            static std::string crlf = "\r\n";
+            do_write();
+
+            if (need_to_start_read_after_complete_ && !continue_posted_)
+            {
+                // not from inside response::end(); the next request's handler
+                // would run nested in this one
+                continue_posted_ = true;
+                io_service_.post([this]{ continue_posted_ = false; continue_reading(); });
+            }
+        }
 
-            buffers_.clear();
-            buffers_.reserve(4*(res.headers.size()+5)+3);
+    private:
+        // answers the message being parsed without reading the rest of it;
+        // the connection is closed after the response
+        void reject_request(int code)
+        {
+            close_connection_ = true;
+            linger_on_close_ = true;
+            pipeline_entry& entry = *next_entry_;
+            pipeline_.push_back(next_entry_);
+            next_entry_ = nullptr;
+            parser_.pause();
+            if (!parser_.stream_body)
+                parser_.move_to_request(entry.req);
+            entry.res = response(code);
+            complete_request(entry);
+        }
 
-            if (res.body.empty() && res.json_value.t() == json::type::Object)
+        // small files are read into the body and written together with the
+        // header; a separate write of their own would cost more than the copy
+        void copy_file_body(pipeline_entry& entry)
+        {
+#ifndef _WIN32
+            auto& file = entry.res.file_;
+            entry.body.resize(file.size);
+            size_t size = 0;
+            while(size < file.size)
             {
-                res.body = json::dump(res.json_value);
+                ssize_t n = ::pread(file.fd, &entry.body[size], file.size - size, file.offset + size);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                {
+                    // Content-Length can't be kept; the client sees the connection close early
+                    CROW_LOG_ERROR << "Could not read the file of a response: " << (n < 0 ? strerror(errno) : "unexpected end of file");
+                    entry.body.resize(size);
+                    close_connection_ = true;
+                    break;
+                }
+                size += n;
             }
+            entry.res.close_file();
+#endif
+        }
 
-            if (!statusCodes.count(res.code))
-                res.code = 500;
+        // a streamed response is written as far as it has been produced
+        void flush_stream(pipeline_entry& entry)
+        {
+            if (!adaptor_.is_open())
+                return;
+            if (wait_state_ == wait_state::handler)
+                cancel_deadline_timer();
+            serialize_header(entry);
+            do_write();
+        }
+
+#ifdef CROW_ENABLE_COMPRESSION
+        // replaces res.body with its gzip or deflate encoding if the route or
+        // the app asks for compression and the client accepts it
+        void compress_body(pipeline_entry& entry)
+        {
+            response& res = entry.res;
+            const compression_options* options = res.compression_ ? res.compression_ : handler_->get_compression();
+            if (!options || options->level == 0 || res.body.size() < options->min_size || res.has_file() || res.shared_body_)
+                return;
+            known_headers known;
+            known.add(res.headers);
+            if (known.has(known_header::content_encoding) || known.has(known_header::content_length) ||
+                compression::is_compressed_type(known.get(known_header::content_type)))
+                return;
+
+            // the body depends on Accept-Encoding from here on
+            if (!known.has(known_header::vary))
+                res.add_header("Vary", "Accept-Encoding");
+            else
             {
-                auto& status = statusCodes.find(res.code)->second;
-                buffers_.emplace_back(status.data(), status.size());
+                auto vary = res.headers.find("vary");
+                if (vary->second != "*" && !boost::icontains(vary->second, "accept-encoding"))
+                    vary->second += ", Accept-Encoding";
             }
 
-            if (res.code >= 400 && res.body.empty())
-                res.body = statusCodes[res.code].substr(9);
+            string_view accept = entry.req.get_header_view(known_header::accept_encoding);
+            compression::algorithm algo;
+            const char* coding;
+            if (accepts_encoding(accept, "gzip"))
+                algo = compression::GZIP, coding = "gzip";
+            else if (accepts_encoding(accept, "deflate"))
+                algo = compression::DEFLATE, coding = "deflate";
+            else
+                return;
 
-            for(auto& kv : res.headers)
+            // entry.body is free until the body is swapped into it; its buffer
+            // takes the output and then holds the uncompressed body for reuse
+            if (!compression::compress(res.body, algo, options->level, entry.body))
             {
-                buffers_.emplace_back(kv.first.data(), kv.first.size());
-                buffers_.emplace_back(seperator.data(), seperator.size());
-                buffers_.emplace_back(kv.second.data(), kv.second.size());
-                buffers_.emplace_back(crlf.data(), crlf.size());
+                CROW_LOG_WARNING << "Could not compress a response body";
+                return;
+            }
+            res.body.swap(entry.body);
+            res.add_header("Content-Encoding", coding);
+        }
+#endif
+
+        void serialize_header(pipeline_entry& entry)
+        {
+            if (entry.header_serialized)
+                return;
+            entry.header_serialized = true;
+            response& res = entry.res;
+
+            if (detail::status_line(res.code).empty())
+                res.code = 500;
+            const std::string& status = detail::status_line(res.code);
+
+            if (res.code >= 400 && res.body_size() == 0 && !res.streaming_)
+                res.body.assign(status, 9, std::string::npos);
 
+            // status line and headers go into one buffer, so the response is
+            // written as two buffers: this and the body
+            std::string& header = entry.header;
+            header.clear();
+            header += status;
+
+            // the known headers are picked out on the way
+            known_headers known;
+            for(auto& kv : res.headers)
+            {
+                known.add(kv.first, kv.second);
+                header += kv.first;
+                header += ": ";
+                header += kv.second;
+                header += "\r\n";
             }
 
-            if (!res.headers.count("content-length"))
+            if (!known.has(known_header::content_length))
             {
-                content_length_ = std::to_string(res.body.size());
-                static std::string content_length_tag = "Content-Length: ";
-                buffers_.emplace_back(content_length_tag.data(), content_length_tag.size());
-                buffers_.emplace_back(content_length_.data(), content_length_.size());
-                buffers_.emplace_back(crlf.data(), crlf.size());
+                if (!res.streaming_)
+                {
+                    header += "Content-Length: ";
+                    detail::append_number(header, res.body_size());
+                    header += "\r\n";
+                }
+                else if (entry.http_1_1)
+                {
+                    entry.chunked = true;
+                    header += "Transfer-Encoding: chunked\r\n";
+                }
+                else
+                {
+                    // HTTP/1.0 has no chunks; the end of the body is the end of the connection
+                    close_connection_ = true;
+                    entry.add_keep_alive = false;
+                }
             }
-            if (!res.headers.count("server"))
+            if (!known.has(known_header::server))
             {
-                static std::string server_tag = "Server: ";
-                buffers_.emplace_back(server_tag.data(), server_tag.size());
-                buffers_.emplace_back(server_name_.data(), server_name_.size());
-                buffers_.emplace_back(crlf.data(), crlf.size());
+                header += "Server: ";
+                header += server_name_;
+                header += "\r\n";
             }
-            if (!res.headers.count("date"))
+            if (!known.has(known_header::date))
             {
-                static std::string date_tag = "Date: ";
-                date_str_ = get_cached_date_str();
-                buffers_.emplace_back(date_tag.data(), date_tag.size());
-                buffers_.emplace_back(date_str_.data(), date_str_.size());
-                buffers_.emplace_back(crlf.data(), crlf.size());
+                header += "Date: ";
+                header += get_cached_date_str();
+                header += "\r\n";
             }
-            if (add_keep_alive_)
+            if (draining_)
             {
-                static std::string keep_alive_tag = "Connection: Keep-Alive";
-                buffers_.emplace_back(keep_alive_tag.data(), keep_alive_tag.size());
-                buffers_.emplace_back(crlf.data(), crlf.size());
+                if (!known.has(known_header::connection))
+                    header += "Connection: close\r\n";
             }
-
-            buffers_.emplace_back(crlf.data(), crlf.size());
-            res_body_copy_.swap(res.body);
-            buffers_.emplace_back(res_body_copy_.data(), res_body_copy_.size());
-
-            do_write();
-
-            if (need_to_start_read_after_complete_)
+            else if (entry.add_keep_alive && !known.has(known_header::connection))
             {
-                need_to_start_read_after_complete_ = false;
-                start_deadline();
-                do_read();
+                header += "Connection: Keep-Alive\r\n";
             }
+
+            header += "\r\n";
         }
 
-    private:
         void do_read()
         {
             //auto self = this->shared_from_this();
             is_reading = true;
-            adaptor_.socket().async_read_some(boost::asio::buffer(buffer_), 
+            adaptor_.socket().async_read_some(boost::asio::buffer(buffer_), detail::make_custom_alloc_handler(read_handler_memory_,
                 [this](const boost::system::error_code& ec, std::size_t bytes_transferred)
                 {
-                    bool error_while_reading = true;
                     if (!ec)
                     {
-                        bool ret = parser_.feed(buffer_.data(), bytes_transferred);
-                        if (ret && adaptor_.is_open())
-                        {
-                            error_while_reading = false;
-                        }
-                    }
-
-                    if (error_while_reading)
-                    {
-                        cancel_deadline_timer();
-                        parser_.done();
-                        adaptor_.close();
-                        is_reading = false;
-                        CROW_LOG_DEBUG << this << " from read(1)";
-                        check_destroy();
-                    }
-                    else if (close_connection_)
-                    {
-                        cancel_deadline_timer();
-                        parser_.done();
-                        is_reading = false;
-                        check_destroy();
-                        // adaptor will close after write
-                    }
-                    else if (!need_to_call_after_handlers_)
-                    {
-                        start_deadline();
-                        do_read();
+                        process_input(buffer_.data(), bytes_transferred);
                     }
                     else
                     {
-                        // res will be completed later by user
-                        need_to_start_read_after_complete_ = true;
+                        stop_reading_on_error();
                     }
-                });
+                }));
+        }
+
+        // parses received data, then decides whether to read on
+        void process_input(const char* data, size_t size)
+        {
+            parsing_ = true;
+            bool ret = parser_.feed(data, size);
+            parsing_ = false;
+            if (parser_.paused())
+            {
+                unparsed_ = data + parser_.parsed();
+                unparsed_size_ = size - parser_.parsed();
+            }
+            // responses completed while parsing go out in one write
+            do_write();
+
+            if (!ret || !adaptor_.is_open())
+            {
+                stop_reading_on_error();
+            }
+            else if (close_connection_)
+            {
+                cancel_deadline_timer();
+                parser_.done();
+                is_reading = false;
+                check_destroy();
+                // adaptor will close after write
+            }
+            else if (pending_handlers_ || parser_.paused())
+            {
+                // responses will be completed later by user, or the pipeline is full
+                need_to_start_read_after_complete_ = true;
+            }
+            else
+            {
+                start_read_deadline();
+                do_read();
+            }
+        }
+
+        // no read is outstanding while waiting, so the connection can be destroyed
+        void stop_waiting_to_read()
+        {
+            if (need_to_start_read_after_complete_)
+            {
+                need_to_start_read_after_complete_ = false;
+                is_reading = false;
+            }
+        }
+
+        void stop_reading_on_error()
+        {
+            cancel_deadline_timer();
+            parser_.done();
+            close_socket();
+            is_reading = false;
+            CROW_LOG_DEBUG << this << " from read(1)";
+            drain_streams();
+            check_destroy();
+        }
+
+        // after the connection is lost, lets producers of streamed responses
+        // that wait to write notice it
+        void drain_streams()
+        {
+            for(auto entry : pipeline_)
+            {
+                if (entry->res.streaming_)
+                    entry->res.drain(true);
+            }
+        }
+
+        // resumes reading that waited for handlers to complete or for the
+        // pipeline to drain. parsing of data already received only needs room
+        // in the pipeline; new reads also wait for the handlers, as request
+        // views point into the receive buffer.
+        void continue_reading()
+        {
+            if (!need_to_start_read_after_complete_)
+                return;
+            if (parser_.paused())
+            {
+                if (pipeline_.size() >= max_pipeline_depth)
+                    return;
+                need_to_start_read_after_complete_ = false;
+                next_entry_ = acquire_entry();
+                parser_.use_arena(&next_entry_->arena);
+                parser_.resume();
+                process_input(unparsed_, unparsed_size_);
+                return;
+            }
+            if (pending_handlers_)
+                return;
+            need_to_start_read_after_complete_ = false;
+            start_read_deadline();
+            do_read();
+        }
+
+        // takes an entry for the next pipelined request, or stops the parser
+        // after this message if there is no room or no next request.
+        void prepare_next_entry()
+        {
+            if (close_connection_ || pipeline_.size() >= max_pipeline_depth)
+            {
+                next_entry_ = nullptr;
+                parser_.pause();
+                return;
+            }
+            next_entry_ = acquire_entry();
+            parser_.use_arena(&next_entry_->arena);
+        }
+
+        pipeline_entry* acquire_entry()
+        {
+            if (free_entries_.empty())
+            {
+                entries_.emplace_back(new pipeline_entry);
+                return entries_.back().get();
+            }
+            auto entry = free_entries_.back();
+            free_entries_.pop_back();
+            return entry;
+        }
+
+        void release_entry(pipeline_entry* entry)
+        {
+            entry->res.complete_request_handler_ = nullptr;
+            entry->res.is_alive_helper_ = nullptr;
+            entry->res.flush_handler_ = nullptr;
+            entry->res.clear();
+            entry->res.headers = ci_map();
+            parser_.recycle_headers(entry->req.headers);
+            entry->req.header_views.clear();
+            entry->req.body_view.clear();
+            entry->need_to_call_after_handlers = false;
+            entry->add_keep_alive = false;
+            entry->http_1_1 = false;
+            entry->ready = false;
+            entry->header_serialized = false;
+            entry->header_sent = false;
+            entry->chunked = false;
+            entry->body.clear();
+            entry->body_reader = nullptr;
+            free_entries_.push_back(entry);
         }
 
         void do_write()
         {
+            if (is_writing || parsing_)
+                return;
+
+            write_buffers_.clear();
+            writing_count_ = 0;
+            for(auto entry : pipeline_)
+            {
+                if (!entry->header_serialized)
+                    break;
+                if (!entry->header_sent)
+                {
+                    write_buffers_.emplace_back(entry->header.data(), entry->header.size());
+                    entry->header_sent = true;
+                }
+                if (!entry->res.streaming_)
+                {
+                    writing_count_++;
+                    if (entry->res.has_file())
+                    {
+                        // the body follows from the file once the buffers are written
+                        file_entry_ = entry;
+                        break;
+                    }
+                    const std::string& body = entry->res.shared_body_ ? *entry->res.shared_body_ : entry->body;
+                    write_buffers_.emplace_back(body.data(), body.size());
+                    continue;
+                }
+
+                // what has been produced of a streamed response
+                response& res = entry->res;
+                entry->body.swap(res.body);
+                res.sending_ = entry->body.size();
+                if (entry->chunked)
+                {
+                    static const std::string crlf = "\r\n", last_chunk = "0\r\n\r\n";
+                    if (!entry->body.empty())
+                    {
+                        entry->chunk_size.clear();
+                        detail::append_hex(entry->chunk_size, entry->body.size());
+                        entry->chunk_size += crlf;
+                        write_buffers_.emplace_back(entry->chunk_size.data(), entry->chunk_size.size());
+                        write_buffers_.emplace_back(entry->body.data(), entry->body.size());
+                        write_buffers_.emplace_back(crlf.data(), crlf.size());
+                    }
+                    if (entry->ready)
+                        write_buffers_.emplace_back(last_chunk.data(), last_chunk.size());
+                }
+                else
+                {
+                    write_buffers_.emplace_back(entry->body.data(), entry->body.size());
+                }
+                if (!entry->ready)
+                    break;
+                writing_count_++;
+            }
+            // goes out after the responses to all earlier requests
+            if (need_to_send_continue_ && writing_count_ == pipeline_.size() && !file_entry_)
+            {
+                static std::string expect_100_continue = "HTTP/1.1 100 Continue\r\n\r\n";
+                write_buffers_.emplace_back(expect_100_continue.data(), expect_100_continue.size());
+                need_to_send_continue_ = false;
+            }
+            if (write_buffers_.empty())
+                return;
+
             //auto self = this->shared_from_this();
             is_writing = true;
-            boost::asio::async_write(adaptor_.socket(), buffers_, 
+            detail::const_buffers_view buffers{write_buffers_.data(), write_buffers_.data() + write_buffers_.size()};
+            boost::asio::async_write(adaptor_.socket(), buffers, detail::make_custom_alloc_handler(write_handler_memory_,
                 [&](const boost::system::error_code& ec, std::size_t /*bytes_transferred*/)
                 {
-                    is_writing = false;
-                    res.clear();
-                    res_body_copy_.clear();
-                    if (!ec)
+#ifndef _WIN32
+                    // there are no file responses on windows
+                    if (!ec && file_entry_)
                     {
-                        if (close_connection_)
+                        auto& file = file_entry_->res.file_;
+                        file_entry_ = nullptr;
+                        adaptor_.async_send_file(file.fd, file.offset, file.size, [this](const boost::system::error_code& ec)
                         {
-                            adaptor_.close();
-                            CROW_LOG_DEBUG << this << " from write(1)";
-                            check_destroy();
-                        }
+                            finish_write(ec);
+                        });
+                        return;
                     }
-                    else
+#endif
+                    file_entry_ = nullptr;
+                    finish_write(ec);
+                }));
+        }
+
+        // the responses of the first `writing_count_' entries have been written
+        void finish_write(const boost::system::error_code& ec)
+        {
+            is_writing = false;
+            for(size_t i = 0; i < writing_count_; i++)
+                release_entry(pipeline_[i]);
+            pipeline_.erase(pipeline_.begin(), pipeline_.begin() + writing_count_);
+            writing_count_ = 0;
+            pipeline_entry* streaming = nullptr;
+            if (!pipeline_.empty() && pipeline_.front()->res.streaming_)
+            {
+                streaming = pipeline_.front();
+                streaming->body.clear();
+                streaming->res.sending_ = 0;
+            }
+            if (!ec)
+            {
+                if (close_connection_ && pipeline_.empty())
+                {
+                    if (linger_on_close_)
                     {
-                        CROW_LOG_DEBUG << this << " from write(2)";
-                        check_destroy();
+                        lingering_close();
+                        return;
                     }
-                });
+                    close_socket();
+                    CROW_LOG_DEBUG << this << " from write(1)";
+                    check_destroy();
+                    return;
+                }
+                do_write();
+                if (streaming)
+                    streaming->res.drain(false);
+                if (!continue_posted_)
+                    continue_reading();
+            }
+            else
+            {
+                CROW_LOG_DEBUG << this << " from write(2)";
+                close_socket();
+                stop_waiting_to_read();
+                drain_streams();
+                check_destroy();
+            }
+        }
+
+        // the client of a rejected request may still be sending the rest of
+        // it. closing a socket with unread data resets the connection, and the
+        // client could lose the response before reading it; so only the sending
+        // side is shut down, and what arrives is read and dropped until the
+        // client closes, max_linger_size is reached, or 2 seconds pass.
+        void lingering_close()
+        {
+            boost::system::error_code ec;
+            adaptor_.tcp_stream().shutdown(boost::asio::ip::tcp::socket::shutdown_send, ec);
+            if (ec)
+            {
+                close_socket();
+                check_destroy();
+                return;
+            }
+            linger_size_ = 0;
+            start_deadline(wait_state::linger);
+            linger_read();
+        }
+
+        void linger_read()
+        {
+            is_reading = true;
+            adaptor_.tcp_stream().async_read_some(boost::asio::buffer(buffer_), detail::make_custom_alloc_handler(read_handler_memory_,
+                [this](const boost::system::error_code& ec, std::size_t bytes_transferred)
+                {
+                    linger_size_ += bytes_transferred;
+                    if (!ec && adaptor_.is_open() && linger_size_ < max_linger_size)
+                    {
+                        linger_read();
+                        return;
+                    }
+                    cancel_deadline_timer();
+                    close_socket();
+                    is_reading = false;
+                    CROW_LOG_DEBUG << this << " from linger";
+                    check_destroy();
+                }));
+        }
+
+        // is_alive() may be called from other threads, so it reads
+        // socket_open_ instead of the adaptor
+        void close_socket()
+        {
+            socket_open_ = false;
+            adaptor_.close();
         }
 
         void check_destroy()
         {
             CROW_LOG_DEBUG << this << " is_reading " << is_reading << " is_writing " << is_writing;
-            if (!is_reading && !is_writing)
+            if (!is_reading && !is_writing && !pending_handlers_ && !continue_posted_)
             {
+                connection_list_.erase(this);
+                connection_count_--;
+                connection_closed_();
+                reset();
+                if (connection_pool_.release(this))
+                {
+                    CROW_LOG_DEBUG << this << " recycled (idle) ";
+                    return;
+                }
                 CROW_LOG_DEBUG << this << " delete (idle) ";
                 delete this;
             }
         }
 
+        // brings a finished connection back to the freshly constructed state
+        // while keeping the capacity of its buffers.
+        void reset()
+        {
+            cancel_deadline_timer();
+            for(auto entry : pipeline_)
+                release_entry(entry);
+            pipeline_.clear();
+            if (!next_entry_)
+            {
+                next_entry_ = acquire_entry();
+                parser_.use_arena(&next_entry_->arena);
+            }
+            parser_.reset();
+            write_buffers_.clear();
+            writing_count_ = 0;
+            file_entry_ = nullptr;
+            unparsed_size_ = 0;
+
+            close_connection_ = false;
+            linger_on_close_ = false;
+            draining_ = false;
+            need_to_start_read_after_complete_ = false;
+            need_to_send_continue_ = false;
+
+            // a used (ssl) stream cannot be accepted into again
+            adaptor_ = Adaptor(io_service_, adaptor_ctx_);
+        }
+
         void cancel_deadline_timer()
         {
-            CROW_LOG_DEBUG << this << " timer cancelled: " << timer_cancel_key_.first << ' ' << timer_cancel_key_.second;
-            timer_queue.cancel(timer_cancel_key_);
+            CROW_LOG_DEBUG << this << " timer cancelled: " << timer_cancel_key_.index << ' ' << timer_cancel_key_.generation;
+            timers_.cancel(timer_cancel_key_);
+            wait_state_ = wait_state::none;
+        }
+
+        // before a read: a request and its headers must arrive within their
+        // timeouts of the wait starting, a body may not stall for longer than
+        // its timeout between two reads
+        void start_read_deadline()
+        {
+            wait_state state =
+                !parser_.in_message() ? wait_state::request :
+                !parser_.headers_complete() ? wait_state::header : wait_state::body;
+            if (state == wait_state_ && state != wait_state::body)
+                return;
+            start_deadline(state);
         }
 
-        void start_deadline(/*int timeout = 5*/)
+        // closes the connection unless cancelled within the timeout for `state'
+        void start_deadline(wait_state state)
         {
             cancel_deadline_timer();
-            
-            timer_cancel_key_ = timer_queue.add([this]
+            std::chrono::milliseconds timeout =
+                state == wait_state::request ? timeouts_.keep_alive :
+                state == wait_state::header ? timeouts_.header :
+                state == wait_state::body ? timeouts_.body :
+                state == wait_state::linger ? std::chrono::milliseconds(2000) : timeouts_.handler;
+            if (timeout.count() <= 0)
+                return;
+
+            wait_state_ = state;
+            timer_cancel_key_ = timers_.add(timeout, [this]
             {
+                wait_state_ = wait_state::none;
                 if (!adaptor_.is_open())
                 {
                     return;
                 }
-                adaptor_.close();
+                CROW_LOG_DEBUG << this << " timed out";
+                close_socket();
             });
-            CROW_LOG_DEBUG << this << " timer added: " << timer_cancel_key_.first << ' ' << timer_cancel_key_.second;
+            CROW_LOG_DEBUG << this << " timer added: " << timer_cancel_key_.index << ' ' << timer_cancel_key_.generation;
         }
 
     private:
+        boost::asio::io_service& io_service_;
+        typename Adaptor::context* adaptor_ctx_;
         Adaptor adaptor_;
         Handler* handler_;
 
         boost::array<char, 4096> buffer_;
+        detail::handler_memory read_handler_memory_;
+        detail::handler_memory write_handler_memory_;
 
+        // all entries this connection has allocated; the parser uses their arenas
+        std::vector<std::unique_ptr<pipeline_entry>> entries_;
         HTTPParser<Connection> parser_;
-        request req_;
-        response res;
+
+        std::vector<pipeline_entry*> free_entries_;
+        // requests waiting for their responses to be written, in order
+        std::vector<pipeline_entry*> pipeline_;
+        // receives the request being parsed; null while the parser is paused
+        pipeline_entry* next_entry_{};
+        unsigned pending_handlers_{};
+
+        // received, but not parsed yet because the pipeline was full
+        const char* unparsed_{};
+        size_t unparsed_size_{};
 
         bool close_connection_ = false;
+        // whether adaptor_ is open, for response::is_alive() on any thread
+        std::atomic<bool> socket_open_{false};
+        // close with lingering_close, after a rejected request
+        bool linger_on_close_ = false;
+        size_t linger_size_{};
+        bool draining_ = false;
 
         const std::string& server_name_;
-        std::vector<boost::asio::const_buffer> buffers_;
-
-        std::string content_length_;
-        std::string date_str_;
-        std::string res_body_copy_;
+        // responses of the first `writing_count_' entries, written together
+        std::vector<boost::asio::const_buffer> write_buffers_;
+        size_t writing_count_{};
+        // the last of them, whose body is sent from a file after the buffers
+        pipeline_entry* file_entry_{};
 
-        //boost::asio::deadline_timer deadline_;
-        detail::dumb_timer_queue::key timer_cancel_key_;
+        wait_state wait_state_{wait_state::none};
+        detail::timer_wheel::key timer_cancel_key_;
+        connection_timeouts timeouts_;
 
         bool is_reading{};
         bool is_writing{};
-        bool need_to_call_after_handlers_{};
+        bool parsing_{};
         bool need_to_start_read_after_complete_{};
-        bool add_keep_alive_{};
+        bool need_to_send_continue_{};
+        bool continue_posted_{};
 
         std::tuple<Middlewares...>* middlewares_;
-        detail::context<Middlewares...> ctx_;
 
-        std::function<std::string()>& get_cached_date_str;
-        detail::dumb_timer_queue& timer_queue;
+        std::function<const std::string&()>& get_cached_date_str;
+        detail::timer_wheel& timers_;
+        // live connection counter of the owning worker; decremented on destroy
+        std::atomic<unsigned>& connection_count_;
+        // lets the server account for the connection and resume accepting
+        std::function<void()>& connection_closed_;
+        detail::connection_pool<Connection>& connection_pool_;
+        detail::connection_list<Connection>& connection_list_;
+        Connection* list_prev_{};
+        Connection* list_next_{};
+        friend class detail::connection_list<Connection>;
     };
 
 }
@@ -21,6 +21,13 @@
  */
 #ifndef CROW_http_parser_h
 #define CROW_http_parser_h
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+/* SSE4.2 is used if the CPU has it, without building for it */
+#define CROW_SSE42_DISPATCH
+#include <nmmintrin.h>
+#endif
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -536,6 +543,27 @@ enum state
 
 #define CROW_PARSING_HEADER(state) (state <= s_headers_done)
 
+/* Called with the bytes each fast scan skips; for tests and profiling. */
+#ifndef CROW_PARSER_ON_FAST_FORWARD
+#define CROW_PARSER_ON_FAST_FORWARD(ranges, skipped)
+#endif
+
+/* Skips to just before the next byte within `ranges' (see crow_find_range),
+ * counting the skipped bytes against CROW_HTTP_MAX_HEADER_SIZE.
+ */
+#define CROW_FAST_FORWARD(ranges, ranges_size)                       \
+do {                                                                 \
+  const char *next_ = crow_find_range(p + 1, data + len,             \
+                                      ranges, ranges_size);          \
+  CROW_PARSER_ON_FAST_FORWARD(ranges, next_ - (p + 1));              \
+  parser->nread += next_ - (p + 1);                                  \
+  if (parser->nread > (CROW_HTTP_MAX_HEADER_SIZE)) {                 \
+    CROW_SET_ERRNO(HPE_HEADER_OVERFLOW);                             \
+    goto error;                                                      \
+  }                                                                  \
+  p = next_ - 1;                                                     \
+} while (0)
+
 
 enum header_states
   { h_general = 0
@@ -828,6 +856,74 @@ static const uint8_t normal_url_char[32] = {
   return s_dead;
 }
 
+#if defined(__SSE4_2__) || defined(CROW_SSE42_DISPATCH)
+/* Checks 16 bytes per step in the way picohttpparser does. Returns the
+ * first byte of [p, end) within `ranges', or the start of the last bytes
+ * that are fewer than 16.
+ */
+#ifdef CROW_SSE42_DISPATCH
+__attribute__((target("sse4.2")))
+#endif
+inline const char *
+crow_find_range_sse42(const char *p, const char *end, const char *ranges, int ranges_size)
+{
+  __m128i r = _mm_loadu_si128((const __m128i *)ranges);
+  while (end - p >= 16) {
+    __m128i b = _mm_loadu_si128((const __m128i *)p);
+    int i = _mm_cmpestri(r, ranges_size, b, 16,
+        _SIDD_LEAST_SIGNIFICANT | _SIDD_CMP_RANGES | _SIDD_UBYTE_OPS);
+    if (i != 16)
+      return p + i;
+    p += 16;
+  }
+  return p;
+}
+
+/* Whether crow_find_range uses SSE4.2: when built for it, or when the CPU
+ * has it. May be set to 0 to time the scalar loop.
+ */
+inline int &
+crow_find_range_use_sse42()
+{
+#if defined(__SSE4_2__)
+  static int use = 1;
+#else
+  static int use = (__builtin_cpu_init(), __builtin_cpu_supports("sse4.2"));
+#endif
+  return use;
+}
+#endif
+
+/* Returns the first byte in [p, end) that falls into one of the inclusive
+ * ranges given as pairs of bounds in `ranges', or `end' if there is none.
+ * `ranges' must be readable for 16 bytes. Uses SSE4.2 when built for it or,
+ * with GCC and Clang on x86, when the CPU has it; otherwise checks one byte
+ * at a time.
+ */
+inline const char *
+crow_find_range(const char *p, const char *end, const char *ranges, int ranges_size)
+{
+#if defined(__SSE4_2__) || defined(CROW_SSE42_DISPATCH)
+  if (crow_find_range_use_sse42())
+    p = crow_find_range_sse42(p, end, ranges, ranges_size);
+#endif
+  for (; p != end; p++) {
+    unsigned char ch = (unsigned char)*p;
+    int i;
+    for (i = 0; i < ranges_size; i += 2) {
+      if (ch >= (unsigned char)ranges[i] && ch <= (unsigned char)ranges[i + 1])
+        return p;
+    }
+  }
+  return end;
+}
+
+/* bytes that end the fast scan in each state; everything else is consumed
+ * without going through the state machine */
+static const char crow_header_value_stops[17] = "\n\n\r\r";
+static const char crow_url_stops[17] = "\x00 ##??\x7f\xff";
+static const char crow_header_field_stops[17] = "\x00\"(),,//:@[]{{}\xff";
+
 inline size_t http_parser_execute (http_parser *parser,
                             const http_parser_settings *settings,
                             const char *data,
@@ -1417,6 +1513,9 @@ static const int8_t unhex[256] =
               CROW_SET_ERRNO(HPE_INVALID_URL);
               goto error;
             }
+            if (parser->state == s_req_path || parser->state == s_req_query_string) {
+              CROW_FAST_FORWARD(crow_url_stops, 8);
+            }
         }
         break;
       }
@@ -1600,6 +1699,7 @@ static const int8_t unhex[256] =
         if (c) {
           switch (parser->header_state) {
             case h_general:
+              CROW_FAST_FORWARD(crow_header_field_stops, 16);
               break;
 
             case h_C:
@@ -1809,6 +1909,7 @@ static const int8_t unhex[256] =
 
         switch (parser->header_state) {
           case h_general:
+            CROW_FAST_FORWARD(crow_header_value_stops, 4);
             break;
 
           case h_connection:
@@ -2618,6 +2719,7 @@ http_parser_version(void) {
 #undef CROW_KEEP_ALIVE
 #undef CROW_CLOSE
 #undef CROW_PARSING_HEADER
+#undef CROW_FAST_FORWARD
 #undef CROW_CR
 #undef CROW_LF
 #undef CROW_LOWER
@@ -1,13 +1,68 @@
 #pragma once
 
 #include <boost/asio.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
 
 #include "crow/common.h"
 #include "crow/ci_map.h"
+#include "crow/known_headers.h"
 #include "crow/query_string.h"
 
 namespace crow
 {
+    using header_view = std::pair<string_view, string_view>;
+
+    // first header named `key' (case-insensitive), or nullptr
+    inline const header_view* find_header_view(const std::vector<header_view>& headers, string_view key)
+    {
+        for(auto& kv : headers)
+        {
+            if (ci_equal(kv.first, key))
+                return &kv;
+        }
+        return nullptr;
+    }
+
+    // whether an Accept-Encoding value allows `coding': listed, or else
+    // covered by `*', and not with q=0
+    inline bool accepts_encoding(string_view accept, const std::string& coding)
+    {
+        // -1 while not listed
+        double coding_q = -1, any_q = -1;
+        while(!accept.empty())
+        {
+            size_t end = accept.find(',');
+            string_view item = accept.substr(0, end);
+            accept = end == string_view::npos ? string_view() : accept.substr(end + 1);
+
+            while(!item.empty() && item.front() == ' ')
+                item.remove_prefix(1);
+            size_t params = item.find(';');
+            string_view token = item.substr(0, params);
+            while(!token.empty() && token.back() == ' ')
+                token.remove_suffix(1);
+            bool is_coding = ci_equal(token, coding);
+            if (!is_coding && token != "*")
+                continue;
+            double q = 1;
+            if (params != string_view::npos)
+            {
+                std::string q_param = item.substr(params + 1).to_string();
+                q_param.erase(std::remove(q_param.begin(), q_param.end(), ' '), q_param.end());
+                if (q_param.compare(0, 2, "q=") == 0)
+                    q = std::strtod(q_param.c_str() + 2, nullptr);
+            }
+            (is_coding ? coding_q : any_q) = q;
+            if (is_coding)
+                break;
+        }
+        return (coding_q >= 0 ? coding_q : any_q) > 0;
+    }
+
     template <typename T>
     inline const std::string& get_header_value(const T& headers, const std::string& key)
     {
@@ -21,31 +76,89 @@ namespace crow
 
 	struct DetachHelper;
 
-    struct request
+    namespace detail
     {
-        HTTPMethod method;
-        std::string raw_url;
-        std::string url;
-        query_string url_params;
-        ci_map headers;
-        std::string body;
+        class offload_pool;
+
+        // the members of a request. request copies them with the defaulted
+        // copy operations of this struct, then indexes its own headers.
+        struct request_data
+        {
+            HTTPMethod method{HTTPMethod::Get};
+            std::string raw_url;
+            std::string url;
+            query_string url_params;
+            ci_map headers;
+            std::string body;
+
+            // with request views enabled (Crow::request_views), headers and body are
+            // not copied into `headers' and `body'; these point into the connection's
+            // receive buffer instead and are only valid until the request completes.
+            std::vector<header_view> header_views;
+            string_view body_view;
+
+            // the known headers among `headers' or `header_views', filled by the
+            // parser and add_header(). the connection indexes them again after
+            // the middlewares' before_handle (see request::index_headers).
+            known_headers header_slots;
 
-        void* middleware_context{};
-        boost::asio::io_service* io_service{};
+            void* middleware_context{};
+            boost::asio::io_service* io_service{};
+            // the app's offload pool (Crow::offload_threads), if it has one
+            detail::offload_pool* offload_pool{};
+        };
+    }
+
+    struct request : detail::request_data
+    {
+        request() = default;
 
-        request()
-            : method(HTTPMethod::Get)
+        request(HTTPMethod method, std::string raw_url, std::string url, query_string url_params, ci_map headers, std::string body)
         {
+            this->method = method;
+            this->raw_url = std::move(raw_url);
+            this->url = std::move(url);
+            this->url_params = std::move(url_params);
+            this->headers = std::move(headers);
+            this->body = std::move(body);
+            header_slots.add(this->headers);
         }
 
-        request(HTTPMethod method, std::string raw_url, std::string url, query_string url_params, ci_map headers, std::string body)
-            : method(method), raw_url(std::move(raw_url)), url(std::move(url)), url_params(std::move(url_params)), headers(std::move(headers)), body(std::move(body))
+        // copies get slots of their own headers
+        request(const request& r)
+            : request_data(r)
         {
+            index_headers();
         }
 
+        request(request&& r) = default;
+
+        request& operator = (const request& r)
+        {
+            request_data::operator = (r);
+            index_headers();
+            return *this;
+        }
+
+        request& operator = (request&& r) = default;
+
+        // a known header added again replaces the value in its slot, as it
+        // does for get_header_view
         void add_header(std::string key, std::string value)
         {
-            headers.emplace(std::move(key), std::move(value));
+            auto it = headers.emplace(std::move(key), std::move(value));
+            header_slots.set(it->first, it->second);
+        }
+
+        // fills header_slots again from `headers' and `header_views', after
+        // they were changed without add_header(). as in get_header_view,
+        // `headers' comes first.
+        void index_headers()
+        {
+            header_slots.clear();
+            header_slots.add(headers);
+            for(auto& kv : header_views)
+                header_slots.add(kv.first, kv.second);
         }
 
         const std::string& get_header_value(const std::string& key) const
@@ -53,6 +166,39 @@ namespace crow
             return crow::get_header_value(headers, key);
         }
 
+        // works with and without request views
+        string_view get_header_view(const std::string& key) const
+        {
+            auto it = headers.find(key);
+            if (it != headers.end())
+                return it->second;
+            if (auto kv = find_header_view(header_views, key))
+                return kv->second;
+            return {};
+        }
+
+        // a known header without looking it up by name
+        string_view get_header_view(known_header h) const
+        {
+            return header_slots.get(h);
+        }
+
+        bool has_header(known_header h) const
+        {
+            return header_slots.has(h);
+        }
+
+        std::size_t header_count(const std::string& key) const
+        {
+            std::size_t count = headers.count(key);
+            for(auto& kv : header_views)
+            {
+                if (ci_equal(kv.first, key))
+                    count++;
+            }
+            return count;
+        }
+
         template<typename CompletionHandler>
         void post(CompletionHandler handler)
         {
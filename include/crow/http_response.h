@@ -1,19 +1,32 @@
 #pragma once
 #include <string>
 #include <unordered_map>
+#include <cstdint>
+#include <memory>
+#ifdef _WIN32
+#include <fstream>
+#include <sstream>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "crow/json.h"
 #include "crow/http_request.h"
 #include "crow/ci_map.h"
+#include "crow/compression.h"
 
 namespace crow
 {
     template <typename Adaptor, typename Handler, typename ... Middlewares>
     class Connection;
+    class Router;
     struct response
     {
         template <typename Adaptor, typename Handler, typename ... Middlewares>
         friend class crow::Connection;
+        friend class crow::Router;
 
         int code{200};
         std::string body;
@@ -60,6 +73,11 @@ namespace crow
             *this = std::move(r);
         }
 
+        ~response()
+        {
+            close_file();
+        }
+
         response& operator = (const response& r) = delete;
 
         response& operator = (response&& r) noexcept
@@ -69,6 +87,14 @@ namespace crow
             code = r.code;
             headers = std::move(r.headers);
             completed_ = r.completed_;
+            streaming_ = r.streaming_;
+            shared_body_ = std::move(r.shared_body_);
+            if (this != &r)
+            {
+                close_file();
+                file_ = r.file_;
+                r.file_.fd = -1;
+            }
             return *this;
         }
 
@@ -84,6 +110,15 @@ namespace crow
             code = 200;
             headers.clear();
             completed_ = false;
+            shared_body_ = nullptr;
+            close_file();
+            streaming_ = false;
+            sending_ = 0;
+            drain_pending_ = false;
+            drain_handler_ = nullptr;
+#ifdef CROW_ENABLE_COMPRESSION
+            compression_ = nullptr;
+#endif
         }
 
         void redirect(const std::string& location)
@@ -92,9 +127,103 @@ namespace crow
             set_header("Location", location);
         }
 
-        void write(const std::string& body_part)
+#ifndef _WIN32
+        // sends `size' bytes of the open file `fd' from `offset' as the body,
+        // without copying them into `body'. the response closes fd.
+        void set_file(int fd, std::uint64_t offset, std::uint64_t size)
+        {
+            close_file();
+            file_.fd = fd;
+            file_.offset = offset;
+            file_.size = size;
+        }
+#endif
+
+        // sends the regular file at `path' as the body; false if it can't be read
+        bool set_file(const std::string& path)
+        {
+#ifdef _WIN32
+            std::ifstream file(path, std::ios::binary);
+            if (!file)
+                return false;
+            std::ostringstream content;
+            content << file.rdbuf();
+            body = content.str();
+            return true;
+#else
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                return false;
+            struct stat st;
+            if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+            {
+                ::close(fd);
+                return false;
+            }
+            set_file(fd, 0, st.st_size);
+            return true;
+#endif
+        }
+
+        bool has_file() const noexcept
+        {
+            return file_.fd >= 0;
+        }
+
+        // sends `content' as the body instead of `body', without copying it;
+        // for data that many responses share, like cached files
+        void set_shared_body(std::shared_ptr<const std::string> content)
+        {
+            shared_body_ = std::move(content);
+        }
+
+        // above this many buffered bytes, write() on a streamed response returns false
+        static const std::size_t max_buffered_size = 64*1024;
+
+        // sends the status line and headers right away; after that, every
+        // write() is sent as it is made (as a chunk, unless a Content-Length
+        // header was set) and end() finishes the response. changes to headers
+        // made after this, e.g. by middlewares' after_handle, are not sent.
+        void stream()
+        {
+            if (streaming_ || completed_)
+                return;
+            streaming_ = true;
+            if (flush_handler_)
+                flush_handler_();
+        }
+
+        bool is_streaming() const noexcept
+        {
+            return streaming_;
+        }
+
+        // returns false when the client can't keep up with a streamed response;
+        // the data is still queued, but the writer should wait for the drain handler.
+        bool write(const std::string& body_part)
         {
             body += body_part;
+            if (!streaming_)
+                return true;
+            if (flush_handler_)
+                flush_handler_();
+            if (buffered_amount() < max_buffered_size)
+                return true;
+            drain_pending_ = true;
+            return false;
+        }
+
+        // bytes of a streamed response passed to write() but not sent yet
+        std::size_t buffered_amount() const noexcept
+        {
+            return body.size() + sending_;
+        }
+
+        // called when write() would succeed again after it returned false,
+        // or when the connection is lost; check is_alive() before writing on.
+        void set_drain_handler(std::function<void()> handler)
+        {
+            drain_handler_ = std::move(handler);
         }
 
         void end()
@@ -125,6 +254,55 @@ namespace crow
             bool completed_{};
             std::function<void()> complete_request_handler_;
             std::function<bool()> is_alive_helper_;
+            std::function<void()> flush_handler_;
+
+            // a body sent from a file instead of `body'
+            struct file_info
+            {
+                int fd{-1};
+                std::uint64_t offset{};
+                std::uint64_t size{};
+            } file_;
+
+            std::shared_ptr<const std::string> shared_body_;
+
+#ifdef CROW_ENABLE_COMPRESSION
+            // settings of the matched route, if it has its own; set by the
+            // router and, like the handlers above, kept across assignment
+            const compression_options* compression_{};
+#endif
+
+            // bytes of the body that will be sent
+            std::uint64_t body_size() const noexcept
+            {
+                if (has_file())
+                    return file_.size;
+                return shared_body_ ? shared_body_->size() : body.size();
+            }
+
+            void close_file()
+            {
+#ifndef _WIN32
+                if (file_.fd >= 0)
+                    ::close(file_.fd);
+#endif
+                file_.fd = -1;
+            }
+
+            bool streaming_{};
+            // bytes taken from `body' by the connection and being written
+            std::size_t sending_{};
+            bool drain_pending_{};
+            std::function<void()> drain_handler_;
+
+            void drain(bool force)
+            {
+                if (!drain_pending_ || !drain_handler_ || (!force && buffered_amount() >= max_buffered_size))
+                    return;
+                drain_pending_ = false;
+                auto handler = drain_handler_;
+                handler();
+            }
 
             //In case of a JSON object, set the Content-Type header
             void json_mode()
@@ -10,33 +10,84 @@
 #include <atomic>
 #include <future>
 #include <vector>
+#include <random>
 
 #include <memory>
 
 #include "crow/http_connection.h"
 #include "crow/logging.h"
-#include "crow/dumb_timer_queue.h"
+#include "crow/timer_wheel.h"
 
 namespace crow
 {
     using namespace boost;
     using tcp = asio::ip::tcp;
 
+    // how accepted connections are assigned to worker threads
+    enum class DistributionPolicy
+    {
+        RoundRobin,
+        // worker with the fewest live connections
+        LeastConnections,
+        // less loaded of two randomly chosen workers
+        PowerOfTwoChoices,
+    };
+
     template <typename Handler, typename Adaptor = SocketAdaptor, typename ... Middlewares>
     class Server
     {
+        using connection_t = Connection<Adaptor, Handler, Middlewares...>;
     public:
-    Server(Handler* handler, std::string bindaddr, uint16_t port, std::tuple<Middlewares...>* middlewares = nullptr, uint16_t concurrency = 1, typename Adaptor::context* adaptor_ctx = nullptr)
-            : acceptor_(io_service_, tcp::endpoint(boost::asio::ip::address::from_string(bindaddr), port)),
+    Server(Handler* handler, std::string bindaddr, uint16_t port, std::tuple<Middlewares...>* middlewares = nullptr, uint16_t concurrency = 1, typename Adaptor::context* adaptor_ctx = nullptr, bool reuse_port = false)
+            : acceptor_(io_service_),
             signals_(io_service_, SIGINT, SIGTERM),
             tick_timer_(io_service_),
+            drain_timer_(io_service_),
             handler_(handler),
             concurrency_(concurrency),
             port_(port),
             bindaddr_(bindaddr),
+            reuse_port_(reuse_port),
             middlewares_(middlewares),
             adaptor_ctx_(adaptor_ctx)
         {
+            if (concurrency_ < 1)
+                concurrency_ = 1;
+
+            for(int i = 0; i < concurrency_;  i++)
+                io_service_pool_.emplace_back(new boost::asio::io_service());
+            connection_count_pool_ = std::vector<std::atomic<unsigned>>(concurrency_);
+            accept_paused_ = std::vector<std::atomic<bool>>(concurrency_);
+            for(int i = 0; i < concurrency_;  i++)
+                connection_closed_pool_.emplace_back([this]{ connection_closed(); });
+            for(int i = 0; i < concurrency_;  i++)
+                recycled_connection_pool_.emplace_back(new detail::connection_pool<connection_t>());
+            for(int i = 0; i < concurrency_;  i++)
+                connection_list_pool_.emplace_back(new detail::connection_list<connection_t>());
+
+#ifndef SO_REUSEPORT
+            if (reuse_port_)
+            {
+                CROW_LOG_WARNING << "SO_REUSEPORT is not supported on this platform; using a single acceptor";
+                reuse_port_ = false;
+            }
+#endif
+
+            tcp::endpoint endpoint(boost::asio::ip::address::from_string(bindaddr), port);
+            if (reuse_port_)
+            {
+                // each worker owns a listening socket bound to the same port;
+                // the kernel spreads incoming connections across them.
+                for(auto& io_service : io_service_pool_)
+                {
+                    acceptor_pool_.emplace_back(new tcp::acceptor(*io_service));
+                    listen(*acceptor_pool_.back(), endpoint);
+                }
+            }
+            else
+            {
+                listen(acceptor_, endpoint);
+            }
         }
 
         void set_tick_function(std::chrono::milliseconds d, std::function<void()> f)
@@ -45,6 +96,56 @@ namespace crow
             tick_function_ = f;
         }
 
+        void set_distribution_policy(DistributionPolicy policy)
+        {
+            distribution_policy_ = policy;
+        }
+
+        // maximum number of finished connections kept per worker for reuse
+        void set_connection_pool_size(size_t size)
+        {
+            for(auto& pool : recycled_connection_pool_)
+                pool->set_max_size(size);
+        }
+
+        void set_request_views(bool enabled)
+        {
+            request_views_ = enabled;
+        }
+
+        void set_timeouts(const connection_timeouts& timeouts)
+        {
+            timeouts_ = timeouts;
+        }
+
+        // at most `total' connections on the server and `per_worker' on each
+        // worker (0 for no limit). at the limit, accepting pauses until a
+        // connection closes; new clients wait in the listen backlog meanwhile.
+        void set_max_connections(unsigned total, unsigned per_worker)
+        {
+            max_connections_ = total;
+            max_connections_per_worker_ = per_worker;
+        }
+
+        // number of live connections handled by each worker
+        std::vector<unsigned> connection_counts() const
+        {
+            std::vector<unsigned> ret;
+            for(auto& count : connection_count_pool_)
+                ret.push_back(count);
+            return ret;
+        }
+
+        // number of live connections; unlike connection_count_, without the
+        // ones reserved for accepts that are pending
+        unsigned connection_count() const
+        {
+            unsigned count = 0;
+            for(auto& c : connection_count_pool_)
+                count += c;
+            return count;
+        }
+
         void on_tick()
         {
             tick_function_();
@@ -59,13 +160,8 @@ namespace crow
 
         void run()
         {
-            if (concurrency_ < 0)
-                concurrency_ = 1;
-
-            for(int i = 0; i < concurrency_;  i++)
-                io_service_pool_.emplace_back(new boost::asio::io_service());
             get_cached_date_str_pool_.resize(concurrency_);
-            timer_queue_pool_.resize(concurrency_);
+            timer_wheel_pool_.resize(concurrency_);
 
             std::vector<std::future<void>> v;
             std::atomic<int> init_count(0);
@@ -92,7 +188,7 @@ namespace crow
                                 date_str.resize(date_str_sz);
                             };
                             update_date_str();
-                            get_cached_date_str_pool_[i] = [&]()->std::string
+                            get_cached_date_str_pool_[i] = [&]()->const std::string&
                             {
                                 if (std::chrono::steady_clock::now() - last >= std::chrono::seconds(1))
                                 {
@@ -102,23 +198,13 @@ namespace crow
                                 return date_str;
                             };
 
-                            // initializing timer queue
-                            detail::dumb_timer_queue timer_queue;
-                            timer_queue_pool_[i] = &timer_queue;
-
-                            timer_queue.set_io_service(*io_service_pool_[i]);
-                            boost::asio::deadline_timer timer(*io_service_pool_[i]);
-                            timer.expires_from_now(boost::posix_time::seconds(1));
-
-                            std::function<void(const boost::system::error_code& ec)> handler;
-                            handler = [&](const boost::system::error_code& ec){
-                                if (ec)
-                                    return;
-                                timer_queue.process();
-                                timer.expires_from_now(boost::posix_time::seconds(1));
-                                timer.async_wait(handler);
-                            };
-                            timer.async_wait(handler);
+                            // connection timeouts of this worker
+                            detail::timer_wheel timer_wheel;
+                            timer_wheel_pool_[i] = &timer_wheel;
+                            timer_wheel.set_io_service(*io_service_pool_[i]);
+
+                            // the worker has no pending operations while it waits for connections
+                            boost::asio::io_service::work work(*io_service_pool_[i]);
 
                             init_count ++;
                             while(1)
@@ -149,7 +235,7 @@ namespace crow
             }
 
             CROW_LOG_INFO << server_name_ << " server is running at " << bindaddr_ <<":" << port_
-                          << " using " << concurrency_ << " threads";
+                          << " using " << concurrency_ << " threads" << (reuse_port_ ? " (SO_REUSEPORT)" : "");
             CROW_LOG_INFO << "Call `app.loglevel(crow::LogLevel::Warning)` to hide Info level logs.";
 
             signals_.async_wait(
@@ -160,7 +246,15 @@ namespace crow
             while(concurrency_ != init_count)
                 std::this_thread::yield();
 
-            do_accept();
+            if (reuse_port_)
+            {
+                for(unsigned i = 0; i < acceptor_pool_.size(); i++)
+                    io_service_pool_[i]->post([this, i]{ do_worker_accept(i); });
+            }
+            else
+            {
+                do_accept();
+            }
 
             std::thread([this]{
                 io_service_.run();
@@ -175,56 +269,313 @@ namespace crow
                 io_service->stop();
         }
 
+        // stops accepting and lets every connection finish the requests it has
+        // begun, then stops. connections still open after `timeout' are cut off.
+        // `on_stopped' is called on one of the server's threads at the end.
+        void stop_gracefully(std::chrono::milliseconds timeout, std::function<void()> on_stopped)
+        {
+            io_service_.post([this, timeout, on_stopped]
+            {
+                if (draining_)
+                    return;
+                CROW_LOG_INFO << "Stopping; waiting for " << connection_count_ << " connections";
+                on_stopped_ = on_stopped;
+                draining_ = true;
+
+                boost::system::error_code ec;
+                acceptor_.close(ec);
+                drain_timer_.expires_from_now(boost::posix_time::milliseconds(timeout.count()));
+                drain_timer_.async_wait([this](const boost::system::error_code& ec)
+                    {
+                        if (ec)
+                            return;
+                        CROW_LOG_WARNING << "Stopping; closing " << connection_count_ << " connections";
+                        // the workers close what is left before they are stopped
+                        auto left = std::make_shared<std::atomic<unsigned>>(io_service_pool_.size());
+                        for(unsigned i = 0; i < io_service_pool_.size(); i++)
+                        {
+                            io_service_pool_[i]->post([this, i, left]
+                            {
+                                connection_list_pool_[i]->for_each([](connection_t* c){ c->close(); });
+                                if (--*left == 0)
+                                    io_service_.post([this]{ finish_stop(); });
+                            });
+                        }
+                    });
+
+                for(unsigned i = 0; i < io_service_pool_.size(); i++)
+                {
+                    io_service_pool_[i]->post([this, i]
+                    {
+                        if (reuse_port_)
+                        {
+                            boost::system::error_code ec;
+                            acceptor_pool_[i]->close(ec);
+                        }
+                        connection_list_pool_[i]->for_each([](connection_t* c){ c->drain(); });
+                    });
+                }
+                // a paused acceptor holds no connection that could report back
+                if (!connection_count_)
+                    finish_stop();
+            });
+        }
+
     private:
-        asio::io_service& pick_io_service()
+#ifdef SO_REUSEPORT
+        using reuse_port_option = boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
+        void listen(tcp::acceptor& acceptor, const tcp::endpoint& endpoint)
+        {
+            acceptor.open(endpoint.protocol());
+            acceptor.set_option(tcp::acceptor::reuse_address(true));
+#ifdef SO_REUSEPORT
+            if (reuse_port_)
+                acceptor.set_option(reuse_port_option(true));
+#endif
+            acceptor.bind(endpoint);
+            acceptor.listen();
+        }
+
+        unsigned pick_io_service()
+        {
+            switch(distribution_policy_)
+            {
+                case DistributionPolicy::LeastConnections:
+                    {
+                        unsigned best = 0;
+                        for(unsigned i = 1; i < connection_count_pool_.size(); i++)
+                        {
+                            if (connection_count_pool_[i] < connection_count_pool_[best])
+                                best = i;
+                        }
+                        return best;
+                    }
+                case DistributionPolicy::PowerOfTwoChoices:
+                    if (io_service_pool_.size() > 1)
+                    {
+                        std::uniform_int_distribution<unsigned> dist(0, io_service_pool_.size()-1);
+                        unsigned a = dist(random_engine_);
+                        // `b' is one of the other workers
+                        std::uniform_int_distribution<unsigned> dist2(0, io_service_pool_.size()-2);
+                        unsigned b = dist2(random_engine_);
+                        if (b >= a)
+                            ++b;
+                        return connection_count_pool_[b] < connection_count_pool_[a] ? b : a;
+                    }
+                    return 0;
+                default:
+                    roundrobin_index_++;
+                    if (roundrobin_index_ >= io_service_pool_.size())
+                        roundrobin_index_ = 0;
+                    return roundrobin_index_;
+            }
+        }
+
+        bool worker_is_full(unsigned index) const
+        {
+            return max_connections_per_worker_ && connection_count_pool_[index] >= max_connections_per_worker_;
+        }
+
+        // counts a connection about to be accepted on worker `index';
+        // false if that would exceed a limit
+        bool reserve_connection(unsigned index)
+        {
+            if (worker_is_full(index))
+                return false;
+            if (++connection_count_ > max_connections_ && max_connections_)
+            {
+                connection_count_--;
+                return false;
+            }
+            return true;
+        }
+
+        // whether acceptor `index' may find room for a connection
+        bool can_accept(unsigned index) const
+        {
+            if (max_connections_ && connection_count_ >= max_connections_)
+                return false;
+            if (reuse_port_)
+                return !worker_is_full(index);
+            for(unsigned i = 0; i < connection_count_pool_.size(); i++)
+            {
+                if (!worker_is_full(i))
+                    return true;
+            }
+            return false;
+        }
+
+        void resume_accept(unsigned index)
+        {
+            CROW_LOG_DEBUG << "Resuming accept " << index;
+            if (reuse_port_)
+                io_service_pool_[index]->post([this, index]{ do_worker_accept(index); });
+            else
+                io_service_.post([this]{ do_accept(); });
+        }
+
+        // acceptor `index' waits until connection_closed() resumes it
+        void pause_accept(unsigned index)
         {
-            // TODO load balancing
-            roundrobin_index_++;
-            if (roundrobin_index_ >= io_service_pool_.size())
-                roundrobin_index_ = 0;
-            return *io_service_pool_[roundrobin_index_];
+            CROW_LOG_DEBUG << "Connection limit reached, pausing accept " << index;
+            accept_paused_[index] = true;
+            // a connection may have closed since the limit was checked
+            if (can_accept(index) && accept_paused_[index].exchange(false))
+                resume_accept(index);
+        }
+
+        // called by connections of any worker as they are destroyed
+        void connection_closed()
+        {
+            if (--connection_count_ == 0 && draining_)
+            {
+                io_service_.post([this]{ finish_stop(); });
+                return;
+            }
+            for(unsigned i = 0; i < accept_paused_.size(); i++)
+            {
+                if (accept_paused_[i] && accept_paused_[i].exchange(false))
+                    resume_accept(i);
+            }
+        }
+
+        // on the main thread, when stopping gracefully
+        void finish_stop()
+        {
+            if (stopped_)
+                return;
+            stopped_ = true;
+            boost::system::error_code ec;
+            drain_timer_.cancel(ec);
+            stop();
+            if (on_stopped_)
+                on_stopped_();
         }
 
         void do_accept()
         {
-            asio::io_service& is = pick_io_service();
-            auto p = new Connection<Adaptor, Handler, Middlewares...>(
-                is, handler_, server_name_, middlewares_,
-                get_cached_date_str_pool_[roundrobin_index_], *timer_queue_pool_[roundrobin_index_],
-                adaptor_ctx_);
+            if (draining_)
+                return;
+            unsigned index = pick_io_service();
+            if (worker_is_full(index))
+            {
+                for(unsigned i = 0; i < connection_count_pool_.size(); i++)
+                {
+                    if (connection_count_pool_[i] < connection_count_pool_[index])
+                        index = i;
+                }
+            }
+            if (!reserve_connection(index))
+            {
+                pause_accept(0);
+                return;
+            }
+            asio::io_service& is = *io_service_pool_[index];
+            auto p = recycled_connection_pool_[index]->acquire();
+            if (!p)
+            {
+                p = new connection_t(
+                    is, handler_, server_name_, middlewares_,
+                    get_cached_date_str_pool_[index], *timer_wheel_pool_[index],
+                    connection_count_pool_[index], connection_closed_pool_[index],
+                    *recycled_connection_pool_[index], *connection_list_pool_[index], adaptor_ctx_);
+            }
+            p->set_request_views(request_views_);
+            p->set_timeouts(timeouts_);
             acceptor_.async_accept(p->socket(),
-                [this, p, &is](boost::system::error_code ec)
+                [this, p, index, &is](boost::system::error_code ec)
                 {
                     if (!ec)
                     {
-                        is.post([p]
+                        connection_count_pool_[index]++;
+                        is.post([this, p]
                         {
-                            p->start();
+                            p->start(draining_);
                         });
                     }
                     else
                     {
                         delete p;
+                        connection_closed();
                     }
                     do_accept();
                 });
         }
 
+        // SO_REUSEPORT mode: accepts on the worker's own acceptor, so the connection never leaves its thread.
+        void do_worker_accept(unsigned index)
+        {
+            if (draining_)
+                return;
+            if (!reserve_connection(index))
+            {
+                pause_accept(index);
+                return;
+            }
+            auto p = recycled_connection_pool_[index]->acquire();
+            if (!p)
+            {
+                p = new connection_t(
+                    *io_service_pool_[index], handler_, server_name_, middlewares_,
+                    get_cached_date_str_pool_[index], *timer_wheel_pool_[index],
+                    connection_count_pool_[index], connection_closed_pool_[index],
+                    *recycled_connection_pool_[index], *connection_list_pool_[index], adaptor_ctx_);
+            }
+            p->set_request_views(request_views_);
+            p->set_timeouts(timeouts_);
+            acceptor_pool_[index]->async_accept(p->socket(),
+                [this, p, index](boost::system::error_code ec)
+                {
+                    if (!ec)
+                    {
+                        connection_count_pool_[index]++;
+                        p->start(draining_);
+                    }
+                    else
+                    {
+                        delete p;
+                        connection_closed();
+                    }
+                    do_worker_accept(index);
+                });
+        }
+
     private:
         asio::io_service io_service_;
         std::vector<std::unique_ptr<asio::io_service>> io_service_pool_;
-        std::vector<detail::dumb_timer_queue*> timer_queue_pool_;
-        std::vector<std::function<std::string()>> get_cached_date_str_pool_;
+        std::vector<detail::timer_wheel*> timer_wheel_pool_;
+        std::vector<std::function<const std::string&()>> get_cached_date_str_pool_;
+        std::vector<std::atomic<unsigned>> connection_count_pool_;
+        std::vector<std::function<void()>> connection_closed_pool_;
+        std::atomic<unsigned> connection_count_{};
+        unsigned max_connections_{};
+        unsigned max_connections_per_worker_{};
+        // acceptors waiting for a connection to close; only [0] without reuse_port
+        std::vector<std::atomic<bool>> accept_paused_;
+        std::vector<std::unique_ptr<detail::connection_pool<connection_t>>> recycled_connection_pool_;
+        std::vector<std::unique_ptr<detail::connection_list<connection_t>>> connection_list_pool_;
         tcp::acceptor acceptor_;
+        std::vector<std::unique_ptr<tcp::acceptor>> acceptor_pool_;
         boost::asio::signal_set signals_;
         boost::asio::deadline_timer tick_timer_;
+        boost::asio::deadline_timer drain_timer_;
+        std::atomic<bool> draining_{false};
+        bool stopped_{false};
+        std::function<void()> on_stopped_;
 
         Handler* handler_;
         uint16_t concurrency_{1};
         std::string server_name_ = "Crow/0.1";
         uint16_t port_;
         std::string bindaddr_;
+        bool reuse_port_{false};
         unsigned int roundrobin_index_{};
+        DistributionPolicy distribution_policy_{DistributionPolicy::RoundRobin};
+        bool request_views_{};
+        connection_timeouts timeouts_;
+        std::minstd_rand random_engine_;
 
         std::chrono::milliseconds tick_interval_;
         std::function<void()> tick_function_;
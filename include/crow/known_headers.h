@@ -0,0 +1,131 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "crow/common.h"
+#include "crow/ci_map.h"
+
+namespace crow
+{
+    // headers the server itself looks at; their values are kept in a
+    // known_headers table as the headers are parsed
+    enum class known_header : unsigned char
+    {
+        host,
+        connection,
+        upgrade,
+        expect,
+        content_length,
+        content_type,
+        content_encoding,
+        accept_encoding,
+        date,
+        server,
+        vary,
+        if_none_match,
+        if_modified_since,
+
+        count
+    };
+
+    inline const char* known_header_name(known_header h)
+    {
+        static const char* names[] = {
+            "Host", "Connection", "Upgrade", "Expect", "Content-Length",
+            "Content-Type", "Content-Encoding", "Accept-Encoding", "Date",
+            "Server", "Vary", "If-None-Match", "If-Modified-Since",
+        };
+        static_assert(sizeof(names)/sizeof(names[0]) == (int)known_header::count, "a name for each known header");
+        return names[(int)h];
+    }
+
+    // the known header named `name' (any case), or known_header::count
+    inline known_header find_known_header(string_view name)
+    {
+        if (name.empty())
+            return known_header::count;
+        auto is = [name](known_header h)
+        {
+            return ci_equal(name, known_header_name(h)) ? h : known_header::count;
+        };
+        // the length and first letter leave at most one candidate
+        char c = name[0] | 0x20;
+        switch(name.size())
+        {
+            case 4:
+                return c == 'h' ? is(known_header::host) : c == 'd' ? is(known_header::date) : is(known_header::vary);
+            case 6:
+                return c == 'e' ? is(known_header::expect) : is(known_header::server);
+            case 7:
+                return is(known_header::upgrade);
+            case 10:
+                return is(known_header::connection);
+            case 12:
+                return is(known_header::content_type);
+            case 13:
+                return is(known_header::if_none_match);
+            case 14:
+                return is(known_header::content_length);
+            case 15:
+                return is(known_header::accept_encoding);
+            case 16:
+                return is(known_header::content_encoding);
+            case 17:
+                return is(known_header::if_modified_since);
+        }
+        return known_header::count;
+    }
+
+    // the first value of each known header of a message. the values are
+    // views of the message's own header storage.
+    class known_headers
+    {
+    public:
+        bool has(known_header h) const
+        {
+            return present_ & (1u << (int)h);
+        }
+
+        // empty if the header is missing
+        string_view get(known_header h) const
+        {
+            return has(h) ? values_[(int)h] : string_view();
+        }
+
+        // keeps `value' if `name' is a known header seen for the first time
+        void add(string_view name, string_view value)
+        {
+            known_header h = find_known_header(name);
+            if (h == known_header::count || has(h))
+                return;
+            values_[(int)h] = value;
+            present_ |= 1u << (int)h;
+        }
+
+        // like add(), but replaces a value kept before
+        void set(string_view name, string_view value)
+        {
+            known_header h = find_known_header(name);
+            if (h == known_header::count)
+                return;
+            values_[(int)h] = value;
+            present_ |= 1u << (int)h;
+        }
+
+        void add(const ci_map& headers)
+        {
+            for(auto& kv : headers)
+                add(kv.first, kv.second);
+        }
+
+        void clear()
+        {
+            present_ = 0;
+        }
+
+    private:
+        std::array<string_view, (int)known_header::count> values_;
+        std::uint32_t present_{};
+    };
+}
@@ -51,7 +51,7 @@ namespace crow
 
         void before_handle(request& req, response& res, context& ctx)
         {
-            int count = req.headers.count("Cookie");
+            int count = req.header_count("Cookie");
             if (!count)
                 return;
             if (count > 1)
@@ -60,7 +60,7 @@ namespace crow
                 res.end();
                 return;
             }
-            std::string cookies = req.get_header_value("Cookie");
+            std::string cookies = req.get_header_view("Cookie").to_string();
             size_t pos = 0;
             while(pos < cookies.size())
             {
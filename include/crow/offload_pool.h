@@ -0,0 +1,190 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "crow/logging.h"
+
+namespace crow
+{
+    // thrown when the offload pool has no room for more work
+    struct offload_queue_full : std::runtime_error
+    {
+        offload_queue_full()
+            : std::runtime_error("offload queue is full")
+        {
+        }
+    };
+
+    namespace detail
+    {
+        // threads for blocking work, kept off the io_service threads. each
+        // thread has its own queue and takes work from the others' when it
+        // runs out. at most `max_queued' tasks wait; try_post() refuses more.
+        class offload_pool
+        {
+        public:
+            offload_pool(unsigned threads, std::size_t max_queued)
+                : queues_(threads ? threads : 1), max_queued_(max_queued)
+            {
+                for(auto& q : queues_)
+                    q.reset(new queue);
+                for(unsigned i = 0; i < queues_.size(); i++)
+                    threads_.emplace_back([this, i]{ run(i); });
+            }
+
+            offload_pool(const offload_pool&) = delete;
+            offload_pool& operator = (const offload_pool&) = delete;
+
+            // runs the tasks still queued, then joins the threads
+            ~offload_pool()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(sleep_mutex_);
+                    stopping_ = true;
+                }
+                wakeup_.notify_all();
+                for(auto& t : threads_)
+                    t.join();
+            }
+
+            // false if `max_queued' tasks are waiting already, or after drain()
+            bool try_post(std::function<void()> f)
+            {
+                if (closed_)
+                    return false;
+                if (queued_.fetch_add(1) >= max_queued_)
+                {
+                    queued_--;
+                    return false;
+                }
+                queue& q = *queues_[next_queue_++ % queues_.size()];
+                {
+                    std::lock_guard<std::mutex> lock(q.mutex);
+                    q.tasks.push_back(std::move(f));
+                }
+                {
+                    // a thread about to sleep either sees the task or is woken
+                    std::lock_guard<std::mutex> lock(sleep_mutex_);
+                }
+                wakeup_.notify_one();
+                return true;
+            }
+
+            // tasks waiting for a thread
+            std::size_t queued() const
+            {
+                return queued_;
+            }
+
+            // refuses new tasks, then waits for the queued and running ones to
+            // finish. a task may call it; it does not wait for itself.
+            void drain()
+            {
+                std::unique_lock<std::mutex> lock(sleep_mutex_);
+                closed_ = true;
+                unsigned self = current_pool() == this ? 1 : 0;
+                idle_.wait(lock, [this, self]{ return !queued_ && running_ <= self; });
+            }
+
+            bool drained() const
+            {
+                return closed_;
+            }
+
+        private:
+            struct queue
+            {
+                std::mutex mutex;
+                std::deque<std::function<void()>> tasks;
+            };
+
+            // the oldest task of the thread's own queue, else the newest of another's
+            bool take(unsigned index, std::function<void()>& f)
+            {
+                for(unsigned i = 0; i < queues_.size(); i++)
+                {
+                    queue& q = *queues_[(index + i) % queues_.size()];
+                    std::lock_guard<std::mutex> lock(q.mutex);
+                    if (q.tasks.empty())
+                        continue;
+                    if (i == 0)
+                    {
+                        f = std::move(q.tasks.front());
+                        q.tasks.pop_front();
+                    }
+                    else
+                    {
+                        f = std::move(q.tasks.back());
+                        q.tasks.pop_back();
+                    }
+                    running_++;
+                    queued_--;
+                    return true;
+                }
+                return false;
+            }
+
+            static offload_pool*& current_pool()
+            {
+                static thread_local offload_pool* pool;
+                return pool;
+            }
+
+            void run(unsigned index)
+            {
+                current_pool() = this;
+                std::function<void()> f;
+                while(1)
+                {
+                    if (take(index, f))
+                    {
+                        try
+                        {
+                            f();
+                        }
+                        catch(std::exception& e)
+                        {
+                            CROW_LOG_ERROR << "An uncaught exception occurred in offloaded work: " << e.what();
+                        }
+                        f = nullptr;
+                        running_--;
+                        if (closed_)
+                        {
+                            std::lock_guard<std::mutex> lock(sleep_mutex_);
+                            idle_.notify_all();
+                        }
+                        continue;
+                    }
+                    std::unique_lock<std::mutex> lock(sleep_mutex_);
+                    if (stopping_)
+                        return;
+                    if (!queued_)
+                        wakeup_.wait(lock);
+                }
+            }
+
+            std::vector<std::unique_ptr<queue>> queues_;
+            std::vector<std::thread> threads_;
+            std::size_t max_queued_;
+            std::atomic<std::size_t> queued_{0};
+            std::atomic<unsigned> running_{0};
+            std::atomic<unsigned> next_queue_{0};
+            std::atomic<bool> closed_{false};
+
+            std::mutex sleep_mutex_;
+            std::condition_variable wakeup_;
+            // signalled after drain() as tasks finish
+            std::condition_variable idle_;
+            bool stopping_{};
+        };
+    }
+}
@@ -4,9 +4,11 @@
 #include <unordered_map>
 #include <boost/algorithm/string.hpp>
 #include <algorithm>
+#include <vector>
 
 #include "crow/http_parser_merged.h"
 #include "crow/http_request.h"
+#include "crow/arena.h"
 
 namespace crow
 {
@@ -17,6 +19,7 @@ namespace crow
         {
             HTTPParser* self = static_cast<HTTPParser*>(self_);
             self->clear();
+            self->in_message_ = true;
             return 0;
         }
         static int on_url(http_parser* self_, const char* at, size_t length)
@@ -28,12 +31,23 @@ namespace crow
         static int on_header_field(http_parser* self_, const char* at, size_t length)
         {
             HTTPParser* self = static_cast<HTTPParser*>(self_);
+            if (self->use_views)
+            {
+                if (self->header_building_state == 0)
+                {
+                    self->header_views.emplace_back(string_view(at, length), string_view());
+                    self->header_building_state = 1;
+                }
+                else
+                    self->append_view(self->header_views.back().first, at, length);
+                return 0;
+            }
             switch (self->header_building_state)
             {
                 case 0:
                     if (!self->header_value.empty())
                     {
-                        self->headers.emplace(std::move(self->header_field), std::move(self->header_value));
+                        self->emplace_header();
                     }
                     self->header_field.assign(at, at+length);
                     self->header_building_state = 1;
@@ -47,6 +61,17 @@ namespace crow
         static int on_header_value(http_parser* self_, const char* at, size_t length)
         {
             HTTPParser* self = static_cast<HTTPParser*>(self_);
+            if (self->use_views)
+            {
+                if (self->header_building_state == 1)
+                {
+                    self->header_views.back().second = string_view(at, length);
+                    self->header_building_state = 0;
+                }
+                else
+                    self->append_view(self->header_views.back().second, at, length);
+                return 0;
+            }
             switch (self->header_building_state)
             {
                 case 0:
@@ -54,7 +79,8 @@ namespace crow
                     break;
                 case 1:
                     self->header_building_state = 0;
-                    self->header_value.assign(at, at+length);
+                    self->reuse_spare_value();
+                    self->header_value.assign(at, length);
                     break;
             }
             return 0;
@@ -62,27 +88,59 @@ namespace crow
         static int on_headers_complete(http_parser* self_)
         {
             HTTPParser* self = static_cast<HTTPParser*>(self_);
-            if (!self->header_field.empty())
+            if (!self->use_views && !self->header_field.empty())
             {
-                self->headers.emplace(std::move(self->header_field), std::move(self->header_value));
+                self->emplace_header();
             }
+            if (self->use_views)
+                self->index_header_views();
+
+            // url params; the handler may route the request before its body
+            auto qs_pos = self->raw_url.find("?");
+            self->url.assign(self->raw_url, 0, qs_pos);
+            if (qs_pos != std::string::npos)
+                self->url_params = query_string(self->raw_url);
+
+            self->headers_complete_ = true;
             self->process_header();
             return 0;
         }
         static int on_body(http_parser* self_, const char* at, size_t length)
         {
             HTTPParser* self = static_cast<HTTPParser*>(self_);
+            self->body_size_ += length;
+            if (self->max_body_size && self->body_size_ > self->max_body_size)
+            {
+                self->handler_->handle_body_too_large();
+                return 0;
+            }
+            if (self->stream_body)
+            {
+                self->handler_->handle_body(at, length);
+                return 0;
+            }
+            if (self->use_views)
+            {
+                if (self->body_view.empty())
+                    self->body_view = string_view(at, length);
+                else if (self->body_view.data() + self->body_view.size() == at)
+                    self->body_view = string_view(self->body_view.data(), self->body_view.size() + length);
+                else
+                {
+                    if (self->body_view.data() != self->body.data())
+                        self->body.assign(self->body_view.data(), self->body_view.size());
+                    self->body.append(at, length);
+                    self->body_view = self->body;
+                }
+                return 0;
+            }
             self->body.insert(self->body.end(), at, at+length);
             return 0;
         }
         static int on_message_complete(http_parser* self_)
         {
             HTTPParser* self = static_cast<HTTPParser*>(self_);
-
-            // url params
-            self->url = self->raw_url.substr(0, self->raw_url.find("?"));
-            self->url_params = query_string(self->raw_url);
-
+            self->in_message_ = false;
             self->process_message();
             return 0;
         }
@@ -92,7 +150,9 @@ namespace crow
             http_parser_init(this, HTTP_REQUEST);
         }
 
-        // return false on error
+        // return false on error.
+        // if pause() is called while handling a message, returns early and
+        // parsed() tells how much of `buffer' was used.
         bool feed(const char* buffer, int length)
         {
             const static http_parser_settings settings_{
@@ -107,7 +167,42 @@ namespace crow
             };
 
             int nparsed = http_parser_execute(this, &settings_, buffer, length);
-            return nparsed == length;
+            parsed_ = nparsed;
+            if (use_views && in_message_)
+                detach_views();
+            return nparsed == length || paused();
+        }
+
+        size_t parsed() const
+        {
+            return parsed_;
+        }
+
+        void pause()
+        {
+            http_parser_pause(this, 1);
+        }
+
+        void resume()
+        {
+            http_parser_pause(this, 0);
+        }
+
+        bool paused() const
+        {
+            return CROW_HTTP_PARSER_ERRNO(this) == HPE_PAUSED;
+        }
+
+        // a message has begun and is not complete yet
+        bool in_message() const
+        {
+            return in_message_;
+        }
+
+        // the headers of the current message are parsed
+        bool headers_complete() const
+        {
+            return headers_complete_;
         }
 
         bool done()
@@ -115,6 +210,13 @@ namespace crow
             return feed(nullptr, 0);
         }
 
+        // prepares the parser for a new connection
+        void reset()
+        {
+            http_parser_init(this, HTTP_REQUEST);
+            clear();
+        }
+
         void clear()
         {
             url.clear();
@@ -122,9 +224,109 @@ namespace crow
             header_building_state = 0;
             header_field.clear();
             header_value.clear();
-            headers.clear();
+            header_views.clear();
+            body_view.clear();
+            header_slots.clear();
+            in_message_ = false;
+            headers_complete_ = false;
+            detached_views_ = 0;
             url_params.clear();
+            max_body_size = 0;
+            stream_body = false;
+            body_size_ = 0;
             body.clear();
+            if (body.capacity() > max_retained_body_size)
+                body.shrink_to_fit();
+
+            recycle_headers(headers);
+            arena_->reset();
+            headers = ci_map(ci_map::allocator_type(arena_));
+        }
+
+        // header nodes of the next messages are allocated from `arena', which
+        // is reset whenever a message begins. without one, the parser uses its own.
+        void use_arena(detail::arena* arena)
+        {
+            arena_ = arena ? arena : &own_arena_;
+        }
+
+        // empties `h'; value strings keep their buffers for upcoming headers
+        void recycle_headers(ci_map& h)
+        {
+            for(auto& kv : h)
+            {
+                if (spare_values_.size() < max_spare_values && kv.second.capacity() > std::string().capacity())
+                    spare_values_.push_back(std::move(kv.second));
+            }
+            h = ci_map();
+        }
+
+        // the receive buffer is about to be overwritten while a message is
+        // still incomplete: copy what the views point at into the arena.
+        void detach_views()
+        {
+            // the last header copied before may have been completed by this read
+            auto& arena = *arena_;
+            for(size_t i = detached_views_ ? detached_views_-1 : 0; i < header_views.size(); i++)
+            {
+                header_views[i].first = copy_to_arena(arena, header_views[i].first);
+                header_views[i].second = copy_to_arena(arena, header_views[i].second);
+            }
+            detached_views_ = header_views.size();
+            // the known headers' views have moved with them
+            if (headers_complete_)
+                index_header_views();
+            if (!body_view.empty() && body_view.data() != body.data())
+            {
+                body.assign(body_view.data(), body_view.size());
+                body_view = body;
+            }
+        }
+
+        // extends `v' by a piece of the same token; copies only if the token
+        // was split between two reads.
+        void append_view(string_view& v, const char* at, size_t length)
+        {
+            if (v.data() + v.size() == at)
+            {
+                v = string_view(v.data(), v.size() + length);
+                return;
+            }
+            char* p = static_cast<char*>(arena_->allocate(v.size() + length, 1));
+            std::copy(v.begin(), v.end(), p);
+            std::copy(at, at + length, p + v.size());
+            v = string_view(p, v.size() + length);
+        }
+
+        static string_view copy_to_arena(detail::arena& arena, string_view v)
+        {
+            if (v.empty())
+                return v;
+            char* p = static_cast<char*>(arena.allocate(v.size(), 1));
+            std::copy(v.begin(), v.end(), p);
+            return string_view(p, v.size());
+        }
+
+        void emplace_header()
+        {
+            auto it = headers.emplace(std::move(header_field), std::move(header_value));
+            header_slots.add(it->first, it->second);
+        }
+
+        void index_header_views()
+        {
+            header_slots.clear();
+            for(auto& kv : header_views)
+                header_slots.add(kv.first, kv.second);
+        }
+
+        void reuse_spare_value()
+        {
+            if (header_value.capacity() <= std::string().capacity() && !spare_values_.empty())
+            {
+                header_value.swap(spare_values_.back());
+                spare_values_.pop_back();
+            }
         }
 
         void process_header()
@@ -142,6 +344,54 @@ namespace crow
             return request{(HTTPMethod)method, std::move(raw_url), std::move(url), std::move(url_params), std::move(headers), std::move(body)};
         }
 
+        // hands the parsed message to `req' by swapping buffers with it,
+        // so both sides keep their capacity for the next message.
+        void move_to_request(request& req)
+        {
+            req.method = (HTTPMethod)method;
+            req.raw_url.swap(raw_url);
+            req.url.swap(url);
+            req.url_params = std::move(url_params);
+            req.headers.swap(headers);
+            // a body collected from several reads lives in `body', possibly in
+            // its inline buffer, which swap() does not move
+            bool body_in_string = !body_view.empty() && body_view.data() == body.data();
+            req.body.swap(body);
+            req.header_views.swap(header_views);
+            req.body_view = body_in_string ? string_view(req.body) : body_view;
+            req.header_slots = header_slots;
+        }
+
+        // hands over everything but the body, before the body is parsed
+        void move_headers_to_request(request& req)
+        {
+            // the views must outlive the receive buffer
+            if (use_views)
+                detach_views();
+            req.method = (HTTPMethod)method;
+            req.raw_url.swap(raw_url);
+            req.url.swap(url);
+            req.url_params = std::move(url_params);
+            req.headers.swap(headers);
+            req.header_views.swap(header_views);
+            req.header_slots = header_slots;
+        }
+
+        string_view get_header_view(const std::string& key) const
+        {
+            if (use_views)
+            {
+                auto kv = find_header_view(header_views, key);
+                return kv ? kv->second : string_view();
+            }
+            return get_header_value(headers, key);
+        }
+
+        string_view get_header_view(known_header h) const
+        {
+            return header_slots.get(h);
+        }
+
 		bool is_upgrade() const
 		{
 			return upgrade;
@@ -152,6 +402,11 @@ namespace crow
             return http_major == major && http_minor == minor;
         }
 
+    private:
+        // declared before `headers', which may use it
+        detail::arena own_arena_;
+
+    public:
         std::string raw_url;
         std::string url;
 
@@ -159,9 +414,35 @@ namespace crow
         std::string header_field;
         std::string header_value;
         ci_map headers;
+        // the known headers of the current message
+        known_headers header_slots;
         query_string url_params;
         std::string body;
 
+        // parse headers and body into views over the fed buffer instead of strings
+        bool use_views = false;
+        std::vector<header_view> header_views;
+        string_view body_view;
+
+        // set by the handler in handle_header() for the current message:
+        // if the body grows beyond `max_body_size' (0 for no limit), the handler's
+        // handle_body_too_large() is called; with `stream_body', the body is
+        // passed to its handle_body() instead of being collected.
+        std::size_t max_body_size = 0;
+        bool stream_body = false;
+
         Handler* handler_;
+
+    private:
+        static const size_t max_retained_body_size = 64*1024;
+        static const size_t max_spare_values = 64;
+
+        detail::arena* arena_{&own_arena_};
+        size_t parsed_{};
+        std::size_t body_size_{};
+        bool in_message_{};
+        bool headers_complete_{};
+        size_t detached_views_{};
+        std::vector<std::string> spare_values_;
     };
 }
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace crow
+{
+    namespace detail
+    {
+        // a perfect hash over a fixed set of strings (hash and displace): the
+        // keys are spread over buckets, and each bucket gets a seed that puts
+        // all of its keys into free slots. a lookup hashes the key once, mixes
+        // in its bucket's seed and compares one key; nothing is probed.
+        class perfect_hash
+        {
+        public:
+            // `keys' must be distinct; values must not be 0. returns false
+            // (and finds nothing) if no seeds were found.
+            bool build(const std::vector<std::pair<std::string, unsigned>>& keys)
+            {
+                clear();
+                if (keys.empty())
+                    return true;
+
+                std::size_t table_size = 1;
+                while(table_size < keys.size() + keys.size()/4)
+                    table_size *= 2;
+
+                for(int attempt = 0; attempt < 4; attempt ++, table_size *= 2)
+                {
+                    if (try_build(keys, table_size))
+                        return true;
+                }
+                clear();
+                return false;
+            }
+
+            void clear()
+            {
+                seeds_.clear();
+                slots_.clear();
+                keys_.clear();
+            }
+
+            // the value of `key', or 0
+            unsigned find(const char* key, std::size_t size) const
+            {
+                if (slots_.empty())
+                    return 0;
+                std::uint64_t h = hash(key, size);
+                const slot& s = slots_[mix(h, seeds_[h % seeds_.size()]) & (slots_.size()-1)];
+                if (s.size != size || memcmp(keys_.data() + s.begin, key, size) != 0)
+                    return 0;
+                return s.value;
+            }
+
+        private:
+            struct slot
+            {
+                std::uint32_t begin{};
+                std::uint32_t size{};
+                unsigned value{};
+            };
+
+            // FNV-1a
+            static std::uint64_t hash(const char* data, std::size_t size)
+            {
+                std::uint64_t h = 14695981039346656037ull;
+                for(std::size_t i = 0; i < size; i ++)
+                {
+                    h ^= (unsigned char)data[i];
+                    h *= 1099511628211ull;
+                }
+                return h;
+            }
+
+            // murmur3's finalizer over the hash and a bucket's seed
+            static std::uint64_t mix(std::uint64_t h, std::uint32_t seed)
+            {
+                h ^= seed * 0x9e3779b97f4a7c15ull;
+                h ^= h >> 33;
+                h *= 0xff51afd7ed558ccdull;
+                h ^= h >> 33;
+                h *= 0xc4ceb9fe1a85ec53ull;
+                h ^= h >> 33;
+                return h;
+            }
+
+            bool try_build(const std::vector<std::pair<std::string, unsigned>>& keys, std::size_t table_size)
+            {
+                std::size_t bucket_count = keys.size()/2 + 1;
+                std::vector<std::vector<unsigned>> buckets(bucket_count);
+                std::vector<std::uint64_t> hashes;
+                for(unsigned i = 0; i < keys.size(); i ++)
+                {
+                    hashes.push_back(hash(keys[i].first.data(), keys[i].first.size()));
+                    buckets[hashes[i] % bucket_count].push_back(i);
+                }
+
+                // the largest buckets are the hardest to place; they go first
+                std::vector<unsigned> order(bucket_count);
+                for(unsigned i = 0; i < bucket_count; i ++)
+                    order[i] = i;
+                std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b){ return buckets[a].size() > buckets[b].size(); });
+
+                seeds_.assign(bucket_count, 0);
+                slots_.assign(table_size, slot());
+                keys_.clear();
+                std::vector<bool> used(table_size);
+                std::vector<std::size_t> placed;
+                for(auto b : order)
+                {
+                    if (buckets[b].empty())
+                        break;
+                    std::uint32_t seed = 1;
+                    for(; seed < (1u << 16); seed ++)
+                    {
+                        placed.clear();
+                        for(auto k : buckets[b])
+                        {
+                            std::size_t s = mix(hashes[k], seed) & (table_size-1);
+                            if (used[s] || std::find(placed.begin(), placed.end(), s) != placed.end())
+                                break;
+                            placed.push_back(s);
+                        }
+                        if (placed.size() == buckets[b].size())
+                            break;
+                    }
+                    if (placed.size() != buckets[b].size())
+                        return false;
+
+                    seeds_[b] = seed;
+                    for(std::size_t i = 0; i < placed.size(); i ++)
+                    {
+                        auto& key = keys[buckets[b][i]];
+                        used[placed[i]] = true;
+                        slots_[placed[i]] = {(std::uint32_t)keys_.size(), (std::uint32_t)key.first.size(), key.second};
+                        keys_ += key.first;
+                    }
+                }
+                return true;
+            }
+
+            std::vector<std::uint32_t> seeds_;
+            std::vector<slot> slots_;
+            std::string keys_;
+        };
+    }
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "crow/common.h"
+
+namespace crow
+{
+    struct route_cache_stats
+    {
+        std::uint64_t hits{};
+        std::uint64_t misses{};
+
+        double hit_rate() const
+        {
+            return hits + misses ? (double)hits / (hits + misses) : 0;
+        }
+    };
+
+    namespace detail
+    {
+        // the rule and parameters found for recent (host, method, url), for
+        // one thread. a url may be kept in one of the 4 entries of the set its
+        // hash picks; the least recently used one is replaced. entries of an
+        // older generation of the routes never hit.
+        class route_cache
+        {
+        public:
+            // urls longer than this are not cached
+            static const std::size_t max_url_size = 256;
+
+            explicit route_cache(std::size_t size)
+            {
+                std::size_t n = ways;
+                while(n < size)
+                    n *= 2;
+                entries_.resize(n);
+            }
+
+            // `count': whether the lookup counts in the hits and misses
+            bool find(unsigned generation, unsigned host, HTTPMethod method, const std::string& url, std::pair<unsigned, routing_params>& found, bool count = true)
+            {
+                std::size_t h = hash(host, method, url);
+                entry* set = &entries_[h & (entries_.size() - ways)];
+                for(unsigned i = 0; i < ways; i ++)
+                {
+                    entry& e = set[i];
+                    if (e.hash == h && e.generation == generation && e.host == host && e.method == method && e.url == url)
+                    {
+                        e.last_used = ++clock_;
+                        found.first = e.rule_index;
+                        found.second = rebase(e.params, e.url.data(), url.data());
+                        if (count)
+                            hits_.store(hits_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                        return true;
+                    }
+                }
+                if (count)
+                    misses_.store(misses_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return false;
+            }
+
+            void insert(unsigned generation, unsigned host, HTTPMethod method, const std::string& url, const std::pair<unsigned, routing_params>& found)
+            {
+                if (url.size() > max_url_size)
+                    return;
+                std::size_t h = hash(host, method, url);
+                entry* set = &entries_[h & (entries_.size() - ways)];
+                entry* e = set;
+                for(unsigned i = 1; i < ways; i ++)
+                {
+                    if (set[i].last_used < e->last_used)
+                        e = &set[i];
+                }
+                e->hash = h;
+                e->generation = generation;
+                e->host = host;
+                e->method = method;
+                e->url = url;
+                e->rule_index = found.first;
+                e->params = rebase(found.second, url.data(), e->url.data());
+                e->last_used = ++clock_;
+            }
+
+            // written by the owning thread only; may be read from any
+            void add_stats(route_cache_stats& stats) const
+            {
+                stats.hits += hits_.load(std::memory_order_relaxed);
+                stats.misses += misses_.load(std::memory_order_relaxed);
+            }
+
+        private:
+            static const unsigned ways = 4;
+
+            struct entry
+            {
+                std::size_t hash{};
+                std::uint64_t last_used{};
+                // 0 is never current
+                unsigned generation{};
+                unsigned host{};
+                HTTPMethod method{};
+                std::string url;
+                unsigned rule_index{};
+                routing_params params;
+            };
+
+            static std::size_t hash(unsigned host, HTTPMethod method, const std::string& url)
+            {
+                std::size_t h = std::hash<std::string>()(url);
+                combine(h, (std::size_t)method);
+                combine(h, host);
+                return h;
+            }
+
+            // as boost::hash_combine
+            static void combine(std::size_t& h, std::size_t value)
+            {
+                h ^= value + 0x9e3779b9 + (h << 6) + (h >> 2);
+            }
+
+            // `params' with its string parameters pointing into `to' instead of `from'
+            static routing_params rebase(const routing_params& params, const char* from, const char* to)
+            {
+                routing_params result = params;
+                result.string_params = {};
+                for(auto& s : params.string_params)
+                    result.string_params.push_back(string_view(to + (s.data() - from), s.size()));
+                return result;
+            }
+
+            std::vector<entry> entries_;
+            std::uint64_t clock_{};
+            std::atomic<std::uint64_t> hits_{};
+            std::atomic<std::uint64_t> misses_{};
+        };
+    }
+}
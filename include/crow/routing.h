@@ -1,10 +1,17 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <cstdint>
+#include <cstring>
+#include <exception>
 #include <utility>
 #include <tuple>
 #include <unordered_map>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <boost/lexical_cast.hpp>
 #include <vector>
 
@@ -14,6 +21,10 @@
 #include "crow/utility.h"
 #include "crow/logging.h"
 #include "crow/websocket.h"
+#include "crow/offload_pool.h"
+#include "crow/perfect_hash.h"
+#include "crow/route_cache.h"
+#include "crow/coroutine.h"
 
 namespace crow
 {
@@ -68,11 +79,44 @@ namespace crow
 
         const std::string& rule() { return rule_; }
 
+        // 0 if the rule has no limit of its own
+        std::size_t get_max_body_size() const
+        {
+            return max_body_size_;
+        }
+
+        bool has_body_reader() const
+        {
+            return (bool)body_reader_;
+        }
+
+        std::function<void(string_view)> make_body_reader(const request& req)
+        {
+            return body_reader_(req);
+        }
+
+#ifdef CROW_ENABLE_COMPRESSION
+        // null if the rule uses the app's settings
+        const compression_options* get_compression() const
+        {
+            return has_compression_ ? &compression_ : nullptr;
+        }
+#endif
+
     protected:
         uint32_t methods_{1<<(int)HTTPMethod::Get};
+        bool offload_{};
+        std::size_t max_body_size_{};
+        std::function<std::function<void(string_view)>(const request&)> body_reader_;
+#ifdef CROW_ENABLE_COMPRESSION
+        compression_options compression_;
+        bool has_compression_{};
+#endif
 
         std::string rule_;
         std::string name_;
+        // lowercase; empty for any host
+        std::string host_;
 
         std::unique_ptr<BaseRule> rule_to_upgrade_;
 
@@ -84,6 +128,15 @@ namespace crow
 
     namespace detail
     {
+        // completes `res' with what a handler returned; coroutine.h adds
+        // handlers returning task<response>
+        template <typename T>
+        void complete_with(response& res, T&& value)
+        {
+            res = response(std::forward<T>(value));
+            res.end();
+        }
+
         namespace routing_handler_call_helper
         {
             template <typename T, int Pos>
@@ -179,8 +232,7 @@ namespace crow
                         [f]
 #endif
                         (const request&, response& res, Args... args){
-                            res = response(f(args...));
-                            res.end();
+                            complete_with(res, f(args...));
                         });
                 }
 
@@ -194,8 +246,7 @@ namespace crow
 
                     void operator()(const request& req, response& res, Args... args)
                     {
-                        res = response(f(req, args...));
-                        res.end();
+                        complete_with(res, f(req, args...));
                     }
 
                     Func f;
@@ -347,6 +398,7 @@ namespace crow
         WebSocketRule& websocket() 
         {
             auto p =new WebSocketRule(((self_t*)this)->rule_);
+            p->host_ = ((self_t*)this)->host_;
             ((self_t*)this)->rule_to_upgrade_.reset(p);
             return *p;
         }
@@ -357,6 +409,17 @@ namespace crow
             return (self_t&)*this;
         }
 
+        // the rule only serves requests whose Host header names `host' (any
+        // port, any case), or a subdomain of it if given as "*.example.com".
+        // rules without a host serve the hosts no rule names.
+        self_t& host(std::string host)
+        {
+            for(auto& c : host)
+                c = std::tolower((unsigned char)c);
+            ((self_t*)this)->host_ = std::move(host);
+            return (self_t&)*this;
+        }
+
         self_t& methods(HTTPMethod method)
         {
             ((self_t*)this)->methods_ = 1 << (int)method;
@@ -371,6 +434,44 @@ namespace crow
             return (self_t&)*this;
         }
 
+        // the handler runs on the app's offload pool (Crow::offload_threads), so it
+        // may block. it should finish with res.end(); completing the response
+        // is passed back to the connection's thread. 503 if the pool is full.
+        self_t& offload()
+        {
+            ((self_t*)this)->offload_ = true;
+            return (self_t&)*this;
+        }
+
+        // requests with a larger body are answered with 413 before it is read
+        self_t& max_body_size(std::size_t size)
+        {
+            ((self_t*)this)->max_body_size_ = size;
+            return (self_t&)*this;
+        }
+
+        // `f(req)' is called as soon as the headers of a request are parsed
+        // and returns a function that receives the body piece by piece as it
+        // arrives; req.body stays empty. the handler runs after the last piece.
+        template <typename Func>
+        self_t& body_reader(Func f)
+        {
+            ((self_t*)this)->body_reader_ = std::move(f);
+            return (self_t&)*this;
+        }
+
+#ifdef CROW_ENABLE_COMPRESSION
+        // overrides the app's compression settings (Crow::use_compression);
+        // level 0 sends the route's responses uncompressed
+        self_t& compression(int level, std::size_t min_size = compression_options().min_size)
+        {
+            ((self_t*)this)->compression_.level = level;
+            ((self_t*)this)->compression_.min_size = min_size;
+            ((self_t*)this)->has_compression_ = true;
+            return (self_t&)*this;
+        }
+#endif
+
     };
 
     class DynamicRule : public BaseRule, public RuleParameterTraits<DynamicRule>
@@ -466,6 +567,8 @@ namespace crow
             }
         }
 
+        // handlers may also be coroutines returning crow::task<crow::response>
+        // (see coroutine.h); the response is sent when they return
         template <typename Func>
         typename std::enable_if<black_magic::CallHelper<Func, black_magic::S<Args...>>::value, void>::type
         operator()(Func&& f)
@@ -483,8 +586,7 @@ namespace crow
                 [f]
 #endif
                 (const request&, response& res, Args ... args){
-                    res = response(f(args...));
-                    res.end();
+                    detail::complete_with(res, f(args...));
                 });
         }
 
@@ -508,8 +610,7 @@ namespace crow
                 [f]
 #endif
                 (const crow::request& req, crow::response& res, Args ... args){
-                    res = response(f(req, args...));
-                    res.end();
+                    detail::complete_with(res, f(req, args...));
                 });
         }
 
@@ -584,58 +685,15 @@ namespace crow
         {
         }
 
-private:
-        void optimizeNode(Node* node)
-        {
-            for(auto x : node->param_childrens)
-            {
-                if (!x)
-                    continue;
-                Node* child = &nodes_[x];
-                optimizeNode(child);
-            }
-            if (node->children.empty())
-                return;
-            bool mergeWithChild = true;
-            for(auto& kv : node->children)
-            {
-                Node* child = &nodes_[kv.second];
-                if (!child->IsSimpleNode())
-                {
-                    mergeWithChild = false;
-                    break;
-                }
-            }
-            if (mergeWithChild)
-            {
-                decltype(node->children) merged;
-                for(auto& kv : node->children)
-                {
-                    Node* child = &nodes_[kv.second];
-                    for(auto& child_kv : child->children)
-                    {
-                        merged[kv.first + child_kv.first] = child_kv.second;
-                    }
-                }
-                node->children = std::move(merged);
-                optimizeNode(node);
-            }
-            else
-            {
-                for(auto& kv : node->children)
-                {
-                    Node* child = &nodes_[kv.second];
-                    optimizeNode(child);
-                }
-            }
-        }
-
-        void optimize()
+        // exact urls of routes without parameters are then looked up in a
+        // perfect hash before the trie is walked
+        void use_literal_hash(bool enabled)
         {
-            optimizeNode(head());
+            use_literal_hash_ = enabled;
+            if (optimized_)
+                optimize();
         }
 
-public:
         void validate()
         {
             if (!head()->IsSimpleNode())
@@ -643,132 +701,24 @@ public:
             optimize();
         }
 
-        std::pair<unsigned, routing_params> find(const std::string& req_url, const Node* node = nullptr, unsigned pos = 0, routing_params* params = nullptr) const
+        std::pair<unsigned, routing_params> find(const std::string& req_url) const
         {
-            routing_params empty;
-            if (params == nullptr)
-                params = &empty;
-
-            unsigned found{};
-            routing_params match_params;
-
-            if (node == nullptr)
-                node = head();
-            if (pos == req_url.size())
-                return {node->rule_index, *params};
-
-            auto update_found = [&found, &match_params](std::pair<unsigned, routing_params>& ret)
-            {
-                if (ret.first && (!found || found > ret.first))
-                {
-                    found = ret.first;
-                    match_params = std::move(ret.second);
-                }
-            };
-
-            if (node->param_childrens[(int)ParamType::INT])
-            {
-                char c = req_url[pos];
-                if ((c >= '0' && c <= '9') || c == '+' || c == '-')
-                {
-                    char* eptr;
-                    errno = 0;
-                    long long int value = strtoll(req_url.data()+pos, &eptr, 10);
-                    if (errno != ERANGE && eptr != req_url.data()+pos)
-                    {
-                        params->int_params.push_back(value);
-                        auto ret = find(req_url, &nodes_[node->param_childrens[(int)ParamType::INT]], eptr - req_url.data(), params);
-                        update_found(ret);
-                        params->int_params.pop_back();
-                    }
-                }
-            }
-
-            if (node->param_childrens[(int)ParamType::UINT])
-            {
-                char c = req_url[pos];
-                if ((c >= '0' && c <= '9') || c == '+')
-                {
-                    char* eptr;
-                    errno = 0;
-                    unsigned long long int value = strtoull(req_url.data()+pos, &eptr, 10);
-                    if (errno != ERANGE && eptr != req_url.data()+pos)
-                    {
-                        params->uint_params.push_back(value);
-                        auto ret = find(req_url, &nodes_[node->param_childrens[(int)ParamType::UINT]], eptr - req_url.data(), params);
-                        update_found(ret);
-                        params->uint_params.pop_back();
-                    }
-                }
-            }
-
-            if (node->param_childrens[(int)ParamType::DOUBLE])
-            {
-                char c = req_url[pos];
-                if ((c >= '0' && c <= '9') || c == '+' || c == '-' || c == '.')
-                {
-                    char* eptr;
-                    errno = 0;
-                    double value = strtod(req_url.data()+pos, &eptr);
-                    if (errno != ERANGE && eptr != req_url.data()+pos)
-                    {
-                        params->double_params.push_back(value);
-                        auto ret = find(req_url, &nodes_[node->param_childrens[(int)ParamType::DOUBLE]], eptr - req_url.data(), params);
-                        update_found(ret);
-                        params->double_params.pop_back();
-                    }
-                }
-            }
-
-            if (node->param_childrens[(int)ParamType::STRING])
-            {
-                size_t epos = pos;
-                for(; epos < req_url.size(); epos ++)
-                {
-                    if (req_url[epos] == '/')
-                        break;
-                }
-
-                if (epos != pos)
-                {
-                    params->string_params.push_back(req_url.substr(pos, epos-pos));
-                    auto ret = find(req_url, &nodes_[node->param_childrens[(int)ParamType::STRING]], epos, params);
-                    update_found(ret);
-                    params->string_params.pop_back();
-                }
-            }
-
-            if (node->param_childrens[(int)ParamType::PATH])
-            {
-                size_t epos = req_url.size();
-
-                if (epos != pos)
-                {
-                    params->string_params.push_back(req_url.substr(pos, epos-pos));
-                    auto ret = find(req_url, &nodes_[node->param_childrens[(int)ParamType::PATH]], epos, params);
-                    update_found(ret);
-                    params->string_params.pop_back();
-                }
-            }
-
-            for(auto& kv : node->children)
-            {
-                const std::string& fragment = kv.first;
-                const Node* child = &nodes_[kv.second];
-
-                if (req_url.compare(pos, fragment.size(), fragment) == 0)
-                {
-                    auto ret = find(req_url, child, pos + fragment.size(), params);
-                    update_found(ret);
-                }
-            }
-
-            return {found, match_params};
+            // validate() builds the flat form; add() keeps it current after that
+            if (!optimized_)
+                throw std::runtime_error("Trie::find() before validate()");
+            if (unsigned rule_index = literal_hash_.find(req_url.data(), req_url.size()))
+                return {rule_index, {}};
+            std::pair<unsigned, routing_params> found{};
+            routing_params params;
+            find(req_url, &flat_nodes_.front(), 0, params, found);
+            return found;
         }
 
         void add(const std::string& url, unsigned rule_index)
         {
             unsigned idx{0};
+            // parameters per routing_params vector; <str> and <path> share one
+            unsigned param_counts[(int)ParamType::MAX]{};
 
             for(unsigned i = 0; i < url.size(); i ++)
             {
@@ -801,6 +751,9 @@ public:
                             }
                             idx = nodes_[idx].param_childrens[(int)x.type];
                             i += x.name.size();
+                            auto& count = param_counts[(int)(x.type == ParamType::PATH ? ParamType::STRING : x.type)];
+                            if (++count > routing_params::max_params)
+                                throw std::runtime_error("too many parameters of one type in " + url);
                             break;
                         }
                     }
@@ -821,6 +774,12 @@ public:
             if (nodes_[idx].rule_index)
                 throw std::runtime_error("handler already exists for " + url);
             nodes_[idx].rule_index = rule_index;
+            if (url.find('<') == std::string::npos)
+                literals_.emplace_back(url, rule_index);
+            // rebuilding on every add() would be quadratic in the number of
+            // routes; before validate() the flat form is left to it
+            if (optimized_)
+                optimize();
         }
     private:
         void debug_node_print(Node* n, int level)
@@ -869,6 +828,204 @@ public:
         }
 
     private:
+        // the read-only form of the trie that find() walks, built by
+        // optimize(): all nodes in one array and all static edges in another,
+        // each node's edges sorted by their first byte. a chain of nodes with
+        // nothing but one static child is a single edge; labels are packed
+        // into one string. only edges whose first byte matches are compared.
+        struct FlatNode
+        {
+            unsigned rule_index{};
+            std::array<unsigned, (int)ParamType::MAX> param_childrens{};
+            unsigned edges_begin{};
+            unsigned edges_end{};
+        };
+
+        struct FlatEdge
+        {
+            unsigned label_begin;
+            unsigned label_size;
+            unsigned child;
+        };
+
+        void optimize()
+        {
+            flat_nodes_.clear();
+            flat_edges_.clear();
+            first_bytes_.clear();
+            labels_.clear();
+            compile(*head());
+
+            // only urls the trie resolves to the route itself; an earlier
+            // route with parameters may match them as well
+            literal_hash_.clear();
+            if (use_literal_hash_)
+            {
+                std::vector<std::pair<std::string, unsigned>> keys;
+                for(auto& kv : literals_)
+                {
+                    std::pair<unsigned, routing_params> found{};
+                    routing_params params;
+                    find(kv.first, &flat_nodes_.front(), 0, params, found);
+                    if (found.first == kv.second)
+                        keys.push_back(kv);
+                }
+                if (!literal_hash_.build(keys))
+                    CROW_LOG_WARNING << "Could not build a perfect hash for " << keys.size() << " routes; using the trie only";
+            }
+            optimized_ = true;
+        }
+
+        // appends `node' and what is below it in preorder; returns its index
+        unsigned compile(const Node& node)
+        {
+            unsigned index = flat_nodes_.size();
+            flat_nodes_.emplace_back();
+            flat_nodes_[index].rule_index = node.rule_index;
+
+            for(int i = 0; i < (int)ParamType::MAX; i ++)
+            {
+                if (node.param_childrens[i])
+                {
+                    unsigned child = compile(nodes_[node.param_childrens[i]]);
+                    flat_nodes_[index].param_childrens[i] = child;
+                }
+            }
+
+            std::vector<std::pair<std::string, unsigned>> edges;
+            for(auto& kv : node.children)
+            {
+                std::string label = kv.first;
+                unsigned child = kv.second;
+                while(nodes_[child].IsSimpleNode() && nodes_[child].children.size() == 1)
+                {
+                    auto& next = *nodes_[child].children.begin();
+                    label += next.first;
+                    child = next.second;
+                }
+                edges.emplace_back(std::move(label), child);
+            }
+            // std::string compares bytes as unsigned char
+            std::sort(edges.begin(), edges.end());
+
+            unsigned begin = flat_edges_.size();
+            flat_nodes_[index].edges_begin = begin;
+            flat_nodes_[index].edges_end = begin + edges.size();
+            for(auto& e : edges)
+            {
+                flat_edges_.push_back({(unsigned)labels_.size(), (unsigned)e.first.size(), 0});
+                first_bytes_ += e.first[0];
+                labels_ += e.first;
+            }
+            for(unsigned i = 0; i < edges.size(); i ++)
+            {
+                unsigned child = compile(nodes_[edges[i].second]);
+                flat_edges_[begin + i].child = child;
+            }
+            return index;
+        }
+
+        // keeps in `found' the earliest rule that matches the rest of the url
+        void find(const std::string& req_url, const FlatNode* node, unsigned pos, routing_params& params, std::pair<unsigned, routing_params>& found) const
+        {
+            if (pos == req_url.size())
+            {
+                if (node->rule_index && (!found.first || found.first > node->rule_index))
+                    found = {node->rule_index, params};
+                return;
+            }
+
+            if (node->param_childrens[(int)ParamType::INT])
+            {
+                char c = req_url[pos];
+                if ((c >= '0' && c <= '9') || c == '+' || c == '-')
+                {
+                    char* eptr;
+                    errno = 0;
+                    long long int value = strtoll(req_url.data()+pos, &eptr, 10);
+                    if (errno != ERANGE && eptr != req_url.data()+pos)
+                    {
+                        params.int_params.push_back(value);
+                        find(req_url, &flat_nodes_[node->param_childrens[(int)ParamType::INT]], eptr - req_url.data(), params, found);
+                        params.int_params.pop_back();
+                    }
+                }
+            }
+
+            if (node->param_childrens[(int)ParamType::UINT])
+            {
+                char c = req_url[pos];
+                if ((c >= '0' && c <= '9') || c == '+')
+                {
+                    char* eptr;
+                    errno = 0;
+                    unsigned long long int value = strtoull(req_url.data()+pos, &eptr, 10);
+                    if (errno != ERANGE && eptr != req_url.data()+pos)
+                    {
+                        params.uint_params.push_back(value);
+                        find(req_url, &flat_nodes_[node->param_childrens[(int)ParamType::UINT]], eptr - req_url.data(), params, found);
+                        params.uint_params.pop_back();
+                    }
+                }
+            }
+
+            if (node->param_childrens[(int)ParamType::DOUBLE])
+            {
+                char c = req_url[pos];
+                if ((c >= '0' && c <= '9') || c == '+' || c == '-' || c == '.')
+                {
+                    char* eptr;
+                    errno = 0;
+                    double value = strtod(req_url.data()+pos, &eptr);
+                    if (errno != ERANGE && eptr != req_url.data()+pos)
+                    {
+                        params.double_params.push_back(value);
+                        find(req_url, &flat_nodes_[node->param_childrens[(int)ParamType::DOUBLE]], eptr - req_url.data(), params, found);
+                        params.double_params.pop_back();
+                    }
+                }
+            }
+
+            if (node->param_childrens[(int)ParamType::STRING])
+            {
+                size_t epos = pos;
+                for(; epos < req_url.size(); epos ++)
+                {
+                    if (req_url[epos] == '/')
+                        break;
+                }
+
+                if (epos != pos)
+                {
+                    params.string_params.push_back(string_view(req_url.data()+pos, epos-pos));
+                    find(req_url, &flat_nodes_[node->param_childrens[(int)ParamType::STRING]], epos, params, found);
+                    params.string_params.pop_back();
+                }
+            }
+
+            if (node->param_childrens[(int)ParamType::PATH])
+            {
+                size_t epos = req_url.size();
+
+                if (epos != pos)
+                {
+                    params.string_params.push_back(string_view(req_url.data()+pos, epos-pos));
+                    find(req_url, &flat_nodes_[node->param_childrens[(int)ParamType::PATH]], epos, params, found);
+                    params.string_params.pop_back();
+                }
+            }
+
+            // first bytes of a node's edges are distinct, so one edge at most
+            const char* first = first_bytes_.data() + node->edges_begin;
+            auto edge = (const char*)memchr(first, req_url[pos], node->edges_end - node->edges_begin);
+            if (edge)
+            {
+                const FlatEdge& e = flat_edges_[edge - first_bytes_.data()];
+                if (req_url.compare(pos, e.label_size, labels_, e.label_begin, e.label_size) == 0)
+                    find(req_url, &flat_nodes_[e.child], pos + e.label_size, params, found);
+            }
+        }
+
         const Node* head() const
         {
             return &nodes_.front();
@@ -886,12 +1043,24 @@ public:
         }
 
         std::vector<Node> nodes_;
+
+        std::vector<FlatNode> flat_nodes_;
+        std::vector<FlatEdge> flat_edges_;
+        std::string first_bytes_;
+        std::string labels_;
+        bool optimized_{};
+
+        // routes without parameters, and a perfect hash of them if enabled
+        std::vector<std::pair<std::string, unsigned>> literals_;
+        detail::perfect_hash literal_hash_;
+        bool use_literal_hash_{};
     };
 
     class Router
     {
     public:
         Router()
+            : hosts_(1), id_(next_id()++)
         {
         }
 
@@ -925,16 +1094,18 @@ public:
                 rule_without_trailing_slash.pop_back();
             }
 
+            auto& per_methods = hosts_[host_index(ruleObject->host_)].per_methods;
             ruleObject->foreach_method([&](int method)
                     {
-                        per_methods_[method].rules.emplace_back(ruleObject);
-                        per_methods_[method].trie.add(rule, per_methods_[method].rules.size() - 1);
+                        per_methods[method].rules.emplace_back(ruleObject);
+                        per_methods[method].trie.add(rule, per_methods[method].rules.size() - 1);
+                        generation_++;
 
                         // directory case: 
                         //   request to `/about' url matches `/about/' rule 
                         if (has_trailing_slash)
                         {
-                            per_methods_[method].trie.add(rule_without_trailing_slash, RULE_SPECIAL_REDIRECT_SLASH);
+                            per_methods[method].trie.add(rule_without_trailing_slash, RULE_SPECIAL_REDIRECT_SLASH);
                         }
                     });
 
@@ -942,21 +1113,97 @@ public:
 
         void validate()
         {
+            // the rules added before one that fails are still served, so
+            // their tries are compiled either way
+            std::exception_ptr error;
             for(auto& rule:all_rules_)
             {
                 if (rule)
                 {
-                    auto upgraded = rule->upgrade();
-                    if (upgraded)
-                        rule = std::move(upgraded);
-                    rule->validate();
-                    internal_add_rule_object(rule->rule(), rule.get());
+                    try
+                    {
+                        auto upgraded = rule->upgrade();
+                        if (upgraded)
+                            rule = std::move(upgraded);
+                        rule->validate();
+                        internal_add_rule_object(rule->rule(), rule.get());
+                    }
+                    catch(...)
+                    {
+                        error = std::current_exception();
+                        break;
+                    }
+                    if (rule->get_max_body_size() || rule->has_body_reader())
+                        has_body_rules_ = true;
+                }
+            }
+            for(auto& host:hosts_)
+            {
+                for(auto& per_method:host.per_methods)
+                {
+                    per_method.trie.use_literal_hash(fixed_routes_);
+                    per_method.trie.validate();
                 }
             }
-            for(auto& per_method:per_methods_)
+            if (error)
+                std::rethrow_exception(error);
+
+            std::vector<std::pair<std::string, unsigned>> exact, wildcard;
+            for(auto& kv : host_indices_)
             {
-                per_method.trie.validate();
+                if (kv.first.compare(0, 2, "*.") == 0)
+                    wildcard.emplace_back(kv.first.substr(1), kv.second);
+                else
+                    exact.emplace_back(kv.first, kv.second);
             }
+            if (!exact_hosts_.build(exact) || !wildcard_hosts_.build(wildcard))
+                throw std::runtime_error("Could not index the hosts of the routes");
+            generation_++;
+        }
+
+        // see Crow::route_cache
+        void set_route_cache(std::size_t entries)
+        {
+            std::lock_guard<std::mutex> lock(caches_mutex_);
+            cache_size_ = entries;
+            // a worker may be using its old cache right now; it is freed when
+            // that worker next looks its cache up
+            for(auto& c : caches_)
+                retired_caches_[c.first] = std::move(c.second);
+            caches_.clear();
+            // threads look their cache up again
+            id_ = next_id()++;
+        }
+
+        route_cache_stats get_route_cache_stats()
+        {
+            route_cache_stats stats;
+            std::lock_guard<std::mutex> lock(caches_mutex_);
+            for(auto& c : caches_)
+                c.second->add_stats(stats);
+            return stats;
+        }
+
+        // see Crow::fixed_routes
+        void set_fixed_routes(bool enabled)
+        {
+            fixed_routes_ = enabled;
+        }
+
+        // the rule a request will be handled by, if it limits or reads bodies
+        // itself. called when the headers are parsed, before the body arrives.
+        BaseRule* find_body_rule(HTTPMethod method, string_view host_header, const std::string& url) const
+        {
+            if (!has_body_rules_ || method >= HTTPMethod::InternalMethodCount)
+                return nullptr;
+            unsigned host = find_host(host_header);
+            auto& per_method = hosts_[host].per_methods[(int)method];
+            // handle() looks the url up again; only that lookup counts in the
+            // cache stats
+            unsigned rule_index = find(host, method, url, true).first;
+            if (!rule_index || rule_index == RULE_SPECIAL_REDIRECT_SLASH || rule_index >= per_method.rules.size())
+                return nullptr;
+            return per_method.rules[rule_index];
         }
 
         template <typename Adaptor> 
@@ -964,11 +1211,10 @@ public:
         {
             if (req.method >= HTTPMethod::InternalMethodCount)
                 return;
-            auto& per_method = per_methods_[(int)req.method];
-            auto& trie = per_method.trie;
-            auto& rules = per_method.rules;
+            unsigned host = find_host(req.get_header_view(known_header::host));
+            auto& rules = hosts_[host].per_methods[(int)req.method].rules;
 
-            auto found = trie.find(req.url);
+            auto found = find(host, req.method, req.url);
             unsigned rule_index = found.first;
             if (!rule_index)
             {
@@ -987,13 +1233,14 @@ public:
                 res = response(301);
 
                 // TODO absolute url building
-                if (req.get_header_value("Host").empty())
+                string_view host = req.get_header_view(known_header::host);
+                if (host.empty())
                 {
                     res.add_header("Location", req.url + "/");
                 }
                 else
                 {
-                    res.add_header("Location", "http://" + req.get_header_value("Host") + req.url + "/");
+                    res.add_header("Location", "http://" + host.to_string() + req.url + "/");
                 }
                 res.end();
                 return;
@@ -1026,11 +1273,10 @@ public:
         {
             if (req.method >= HTTPMethod::InternalMethodCount)
                 return;
-            auto& per_method = per_methods_[(int)req.method];
-            auto& trie = per_method.trie;
-            auto& rules = per_method.rules;
+            unsigned host = find_host(req.get_header_view(known_header::host));
+            auto& rules = hosts_[host].per_methods[(int)req.method].rules;
 
-            auto found = trie.find(req.url);
+            auto found = find(host, req.method, req.url);
 
             unsigned rule_index = found.first;
 
@@ -1051,13 +1297,14 @@ public:
                 res = response(301);
 
                 // TODO absolute url building
-                if (req.get_header_value("Host").empty())
+                string_view host = req.get_header_view(known_header::host);
+                if (host.empty())
                 {
                     res.add_header("Location", req.url + "/");
                 }
                 else
                 {
-                    res.add_header("Location", "http://" + req.get_header_value("Host") + req.url + "/");
+                    res.add_header("Location", "http://" + host.to_string() + req.url + "/");
                 }
                 res.end();
                 return;
@@ -1065,10 +1312,123 @@ public:
 
             CROW_LOG_DEBUG << "Matched rule '" << rules[rule_index]->rule_ << "' " << (uint32_t)req.method << " / " << rules[rule_index]->get_methods();
 
+#ifdef CROW_ENABLE_COMPRESSION
+            res.compression_ = rules[rule_index]->get_compression();
+#endif
+
+            BaseRule& rule = *rules[rule_index];
+            if (rule.offload_ && offload_pool_ && req.io_service)
+                offload(rule, req, res, std::move(found.second));
+            else
+                call(rule, req, res, found.second);
+        }
+
+        void set_offload_pool(detail::offload_pool* pool)
+        {
+            offload_pool_ = pool;
+        }
+
+        void debug_print()
+        {
+            for(auto& kv : host_indices_)
+                CROW_LOG_DEBUG << "host " << kv.first << ": " << kv.second;
+            for(unsigned host = 0; host < hosts_.size(); host ++)
+            {
+                for(int i = 0; i < (int)HTTPMethod::InternalMethodCount; i ++)
+                {
+                    CROW_LOG_DEBUG << host << ' ' << method_name((HTTPMethod)i);
+                    hosts_[host].per_methods[i].trie.debug_print();
+                }
+            }
+        }
+
+    private:
+        // `peek': the route cache is read, but neither filled nor counted
+        std::pair<unsigned, routing_params> find(unsigned host, HTTPMethod method, const std::string& url, bool peek = false) const
+        {
+            detail::route_cache* cache = cache_size_.load(std::memory_order_relaxed) ? thread_cache() : nullptr;
+            std::pair<unsigned, routing_params> found;
+            if (cache && cache->find(generation_, host, method, url, found, !peek))
+                return found;
+            found = hosts_[host].per_methods[(int)method].trie.find(url);
+            if (cache && found.first && !peek)
+                cache->insert(generation_, host, method, url, found);
+            return found;
+        }
+
+        // the index into hosts_ for a host name from a rule, added if new
+        unsigned host_index(const std::string& host)
+        {
+            if (host.empty())
+                return 0;
+            auto it = host_indices_.find(host);
+            if (it != host_indices_.end())
+                return it->second;
+            hosts_.emplace_back();
+            host_indices_.emplace(host, hosts_.size() - 1);
+            return hosts_.size() - 1;
+        }
+
+        // the index into hosts_ for a Host header: its exact name, else the
+        // longest matching wildcard, else 0
+        unsigned find_host(string_view host) const
+        {
+            if (hosts_.size() == 1)
+                return 0;
+            // the port and a trailing dot are not part of the name
+            std::size_t end = host.find(host.starts_with('[') ? ']' : ':');
+            if (end != string_view::npos)
+                host = host.substr(0, host.starts_with('[') ? end + 1 : end);
+            if (host.ends_with('.'))
+                host.remove_suffix(1);
+
+            char name[256];
+            if (host.size() > sizeof(name))
+                return 0;
+            for(std::size_t i = 0; i < host.size(); i ++)
+                name[i] = std::tolower((unsigned char)host[i]);
+
+            if (unsigned index = exact_hosts_.find(name, host.size()))
+                return index;
+            for(std::size_t i = 0; i < host.size(); i ++)
+            {
+                if (name[i] != '.')
+                    continue;
+                if (unsigned index = wildcard_hosts_.find(name + i, host.size() - i))
+                    return index;
+            }
+            return 0;
+        }
+
+        // the calling thread's route cache. each worker has its own, so
+        // lookups take no locks.
+        detail::route_cache* thread_cache() const
+        {
+            thread_local std::pair<std::uint64_t, detail::route_cache*> current{};
+            if (current.first == id_.load(std::memory_order_acquire))
+                return current.second;
+            std::lock_guard<std::mutex> lock(caches_mutex_);
+            // this thread is done with its cache from before set_route_cache
+            retired_caches_.erase(std::this_thread::get_id());
+            auto& cache = caches_[std::this_thread::get_id()];
+            if (!cache)
+                cache.reset(new detail::route_cache(cache_size_));
+            current = {id_, cache.get()};
+            return cache.get();
+        }
+
+        static std::atomic<std::uint64_t>& next_id()
+        {
+            static std::atomic<std::uint64_t> id{1};
+            return id;
+        }
+
+        void call(BaseRule& rule, const request& req, response& res, const routing_params& params)
+        {
             // any uncaught exceptions become 500s
             try
             {
-                rules[rule_index]->handle(req, res, found.second);
+                rule.handle(req, res, params);
             }
             catch(std::exception& e)
             {
@@ -1086,16 +1446,21 @@ public:
             }
         }
 
-        void debug_print()
+        // calls the rule on the offload pool. the connection is only touched
+        // on its own thread, so completing the response is posted back there.
+        void offload(BaseRule& rule, const request& req, response& res, routing_params params)
         {
-            for(int i = 0; i < (int)HTTPMethod::InternalMethodCount; i ++)
+            auto complete = std::move(res.complete_request_handler_);
+            res.complete_request_handler_ = [&req, complete]{ req.io_service->post(complete); };
+            if (!offload_pool_->try_post([this, &rule, &req, &res, params]{ call(rule, req, res, params); }))
             {
-                CROW_LOG_DEBUG << method_name((HTTPMethod)i);
-                per_methods_[i].trie.debug_print();
+                CROW_LOG_WARNING << "Offload queue is full; answering " << req.url << " with 503";
+                res.complete_request_handler_ = std::move(complete);
+                res = response(503);
+                res.end();
             }
         }
 
-    private:
         struct PerMethod
         {
             std::vector<BaseRule*> rules;
@@ -1104,7 +1469,34 @@ public:
             // rule index 0, 1 has special meaning; preallocate it to avoid duplication.
             PerMethod() : rules(2) {}
         };
-        std::array<PerMethod, (int)HTTPMethod::InternalMethodCount> per_methods_;
+        // the routes of one virtual host
+        struct PerHost
+        {
+            std::array<PerMethod, (int)HTTPMethod::InternalMethodCount> per_methods;
+        };
+        // hosts_[0] has the routes without a host
+        std::vector<PerHost> hosts_;
+        // host names and "*.suffix" wildcards of rules
+        std::unordered_map<std::string, unsigned> host_indices_;
+        // wildcards are keyed by their suffix with the dot (".example.com")
+        detail::perfect_hash exact_hosts_;
+        detail::perfect_hash wildcard_hosts_;
         std::vector<std::unique_ptr<BaseRule>> all_rules_;
+        bool has_body_rules_{};
+        bool fixed_routes_{};
+        detail::offload_pool* offload_pool_{};
+
+        // tells apart routers (and their caches) on a thread. set_route_cache
+        // may change it, and the cache size, while workers route requests.
+        std::atomic<std::uint64_t> id_;
+        // entries of the route caches made before the last change to the
+        // routes are ignored
+        unsigned generation_{1};
+        std::atomic<std::size_t> cache_size_{};
+        mutable std::mutex caches_mutex_;
+        mutable std::unordered_map<std::thread::id, std::unique_ptr<detail::route_cache>> caches_;
+        // at most one per thread: set_route_cache leaves a thread without a
+        // cache until it makes a new one, which frees the retired one
+        mutable std::unordered_map<std::thread::id, std::unique_ptr<detail::route_cache>> retired_caches_;
     };
 }
@@ -11,6 +11,9 @@
 /* #ifdef - enables ssl */
 //#define CROW_ENABLE_SSL
 
+/* #ifdef - enables response compression (needs zlib) */
+//#define CROW_ENABLE_COMPRESSION
+
 /* #define - specifies log level */
 /*
     Debug       = 0
@@ -31,6 +34,10 @@
 #define CROW_CAN_USE_CPP14
 #endif
 
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#define CROW_CAN_USE_COROUTINES
+#endif
+
 #if defined(_MSC_VER)
 #if _MSC_VER < 1900
 #define CROW_MSVC_WORKAROUND
@@ -3,12 +3,97 @@
 #ifdef CROW_ENABLE_SSL
 #include <boost/asio/ssl.hpp>
 #endif
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#ifndef _WIN32
+#include <cerrno>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#endif
 #include "crow/settings.h"
 namespace crow
 {
     using namespace boost;
     using tcp = asio::ip::tcp;
 
+#ifndef _WIN32
+    namespace detail
+    {
+        // read-only mapping of a range of a file
+        class mapped_range
+        {
+        public:
+            mapped_range(int fd, std::uint64_t offset, std::size_t size)
+            {
+                std::uint64_t page = sysconf(_SC_PAGESIZE);
+                std::uint64_t start = offset - offset % page;
+                length_ = size + (offset - start);
+                void* p = mmap(nullptr, length_, PROT_READ, MAP_PRIVATE, fd, start);
+                if (p == MAP_FAILED)
+                    return;
+                madvise(p, length_, MADV_SEQUENTIAL);
+                base_ = p;
+                data_ = static_cast<const char*>(p) + (offset - start);
+                size_ = size;
+            }
+
+            mapped_range(const mapped_range&) = delete;
+            mapped_range& operator = (const mapped_range&) = delete;
+
+            ~mapped_range()
+            {
+                if (base_)
+                    munmap(base_, length_);
+            }
+
+            // null if the range could not be mapped
+            const char* data() const
+            {
+                return data_;
+            }
+
+            std::size_t size() const
+            {
+                return size_;
+            }
+
+        private:
+            void* base_{};
+            std::size_t length_{};
+            const char* data_{};
+            std::size_t size_{};
+        };
+
+        // writes a range of a file to `stream' from a mapping of it, so that
+        // it is never copied into a user space buffer of ours
+        template <typename Stream, typename F>
+        void async_write_mapped(Stream& stream, boost::asio::io_service& io_service, int fd, std::uint64_t offset, std::uint64_t size, F f)
+        {
+            if (!size)
+            {
+                io_service.post([f]{ f(boost::system::error_code()); });
+                return;
+            }
+            auto range = std::make_shared<mapped_range>(fd, offset, size);
+            if (!range->data())
+            {
+                boost::system::error_code ec(errno, boost::system::system_category());
+                io_service.post([f, ec]{ f(ec); });
+                return;
+            }
+            boost::asio::async_write(stream, boost::asio::buffer(range->data(), range->size()),
+                [range, f](const boost::system::error_code& ec, std::size_t)
+                {
+                    f(ec);
+                });
+        }
+    }
+#endif
+
     struct SocketAdaptor
     {
         using context = void;
@@ -32,6 +117,12 @@ namespace crow
             return socket_;
         }
 
+        // the tcp stream under any encryption
+        tcp::socket& tcp_stream()
+        {
+            return socket_;
+        }
+
         tcp::endpoint remote_endpoint()
         {
             return socket_.remote_endpoint();
@@ -54,6 +145,77 @@ namespace crow
             f(boost::system::error_code());
         }
 
+#ifndef _WIN32
+        // writes `size' bytes of the file `fd' from `offset', then calls f(ec)
+        template <typename F>
+        void async_send_file(int fd, std::uint64_t offset, std::uint64_t size, F f)
+        {
+#ifdef __linux__
+            // the header went out in a write of its own; don't hold the file
+            // data back until that is acknowledged. both options are only for
+            // the transfer: later responses get the socket as it was.
+            boost::system::error_code ec;
+            tcp::no_delay no_delay;
+            socket_.get_option(no_delay, ec);
+            bool was_no_delay = !ec && no_delay.value();
+            bool was_non_blocking = socket_.native_non_blocking();
+            socket_.set_option(tcp::no_delay(true), ec);
+            socket_.native_non_blocking(true, ec);
+            send_file(fd, offset, size, [this, was_no_delay, was_non_blocking, f](const boost::system::error_code& ec)
+            {
+                boost::system::error_code ignored;
+                if (!was_no_delay)
+                    socket_.set_option(tcp::no_delay(false), ignored);
+                if (!was_non_blocking)
+                    socket_.native_non_blocking(false, ignored);
+                f(ec);
+            });
+#else
+            detail::async_write_mapped(socket_, get_io_service(), fd, offset, size, f);
+#endif
+        }
+#endif
+
+#ifdef __linux__
+        // sendfile(2) copies from the page cache to the socket in the kernel.
+        // the socket must be non-blocking.
+        template <typename F>
+        void send_file(int fd, std::uint64_t offset, std::uint64_t size, F f)
+        {
+            while(size)
+            {
+                off_t off = offset;
+                ssize_t n = ::sendfile(socket_.native_handle(), fd, &off, std::min<std::uint64_t>(size, 1<<30));
+                if (n > 0)
+                {
+                    offset += n;
+                    size -= n;
+                    continue;
+                }
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                {
+                    // continue once the socket is writable again
+                    socket_.async_write_some(boost::asio::null_buffers(),
+                        [this, fd, offset, size, f](const boost::system::error_code& ec, std::size_t)
+                        {
+                            if (ec)
+                                f(ec);
+                            else
+                                send_file(fd, offset, size, f);
+                        });
+                    return;
+                }
+                // n == 0: the file is shorter than the range
+                boost::system::error_code ec(n < 0 ? errno : EIO, boost::system::system_category());
+                get_io_service().post([f, ec]{ f(ec); });
+                return;
+            }
+            get_io_service().post([f]{ f(boost::system::error_code()); });
+        }
+#endif
+
         tcp::socket socket_;
     };
 
@@ -78,6 +240,11 @@ namespace crow
             return ssl_socket_->lowest_layer();
         }
 
+        tcp::socket& tcp_stream()
+        {
+            return ssl_socket_->next_layer();
+        }
+
         tcp::endpoint remote_endpoint()
         {
             return raw_socket().remote_endpoint();
@@ -108,6 +275,15 @@ namespace crow
                     });
         }
 
+#ifndef _WIN32
+        // tls needs the data in user space: the file is mapped and written from there
+        template <typename F>
+        void async_send_file(int fd, std::uint64_t offset, std::uint64_t size, F f)
+        {
+            detail::async_write_mapped(*ssl_socket_, get_io_service(), fd, offset, size, f);
+        }
+#endif
+
         std::unique_ptr<boost::asio::ssl::stream<tcp::socket>> ssl_socket_;
     };
 #endif
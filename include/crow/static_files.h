@@ -0,0 +1,426 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <sys/stat.h>
+#include <boost/algorithm/string/predicate.hpp>
+
+#include "crow/http_request.h"
+#include "crow/http_response.h"
+#include "crow/compression.h"
+
+namespace crow
+{
+    // serves the files of a directory, e.g.
+    //     App<StaticFiles> app;
+    //     app.get_middleware<StaticFiles>().root("public", "/static/");
+    // small files are kept in memory, in an LRU cache bounded by
+    // max_cache_size(), with their ETag, Last-Modified and precompressed
+    // variants (`file.br' and `file.gz', if present and not older than the
+    // file). with CROW_ENABLE_COMPRESSION, a cached file without `file.gz'
+    // gets a gzip variant compressed once as it is loaded. there is no
+    // brotli encoder; brotli is only served from `file.br'. a cached file is
+    // checked against the disk at most once per revalidate_interval(), so
+    // conditional requests mostly get their 304 without any system call.
+    struct StaticFiles
+    {
+        struct context
+        {
+        };
+
+        // serves `directory' under urls that start with `url_prefix'
+        StaticFiles& root(std::string directory, std::string url_prefix = "/static/")
+        {
+            if (!directory.empty() && directory.back() != '/')
+                directory += '/';
+            if (url_prefix.empty() || url_prefix.back() != '/')
+                url_prefix += '/';
+            directory_ = std::move(directory);
+            url_prefix_ = std::move(url_prefix);
+            return *this;
+        }
+
+        // total bytes of file contents kept in memory
+        StaticFiles& max_cache_size(std::size_t size)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            max_cache_size_ = size;
+            evict();
+            return *this;
+        }
+
+        // larger files are sent from disk each time
+        StaticFiles& max_cached_file_size(std::size_t size)
+        {
+            max_cached_file_size_ = size;
+            return *this;
+        }
+
+        StaticFiles& revalidate_interval(std::chrono::milliseconds interval)
+        {
+            revalidate_interval_ = interval;
+            return *this;
+        }
+
+        // bytes of file contents in the cache
+        std::size_t cache_size()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return cache_size_;
+        }
+
+        void before_handle(request& req, response& res, context& /*ctx*/)
+        {
+            if (directory_.empty() || (req.method != HTTPMethod::Get && req.method != HTTPMethod::Head))
+                return;
+            if (req.url.compare(0, url_prefix_.size(), url_prefix_) != 0)
+                return;
+
+            std::string name;
+            if (!decode_path(req.url.substr(url_prefix_.size()), name))
+            {
+                res.code = 404;
+                res.end();
+                return;
+            }
+
+            auto asset = find(name);
+            if (!asset)
+            {
+                res.code = 404;
+                res.end();
+                return;
+            }
+
+            res.set_header("ETag", asset->etag);
+            res.set_header("Last-Modified", asset->last_modified);
+            if (not_modified(req, *asset))
+            {
+                res.code = 304;
+                res.end();
+                return;
+            }
+
+            res.set_header("Content-Type", asset->content_type);
+            const variant* v = &asset->identity;
+            if (asset->brotli.exists || asset->gzip.exists)
+            {
+                res.set_header("Vary", "Accept-Encoding");
+                string_view accept = req.get_header_view(known_header::accept_encoding);
+                if (asset->brotli.exists && accepts_encoding(accept, "br"))
+                {
+                    v = &asset->brotli;
+                    res.set_header("Content-Encoding", "br");
+                }
+                else if (asset->gzip.exists && accepts_encoding(accept, "gzip"))
+                {
+                    v = &asset->gzip;
+                    res.set_header("Content-Encoding", "gzip");
+                }
+            }
+
+            if (req.method == HTTPMethod::Head)
+                res.set_header("Content-Length", std::to_string(v->size));
+            else if (v->content)
+                res.set_shared_body(v->content);
+            else if (!res.set_file(v->path))
+                res.code = 404;
+            res.end();
+        }
+
+        void after_handle(request& /*req*/, response& /*res*/, context& /*ctx*/)
+        {
+        }
+
+    private:
+        struct variant
+        {
+            bool exists{};
+            std::string path;
+            std::uint64_t size{};
+            time_t mtime{};
+            // null if not cached
+            std::shared_ptr<const std::string> content;
+        };
+
+        struct asset
+        {
+            variant identity, gzip, brotli;
+            std::string etag;
+            std::string last_modified;
+            std::string content_type;
+            std::chrono::steady_clock::time_point checked;
+            std::size_t cost{};
+            std::list<std::string>::iterator lru;
+        };
+
+        // the asset for `name', from the cache or loaded from disk; null if there is no such file
+        std::shared_ptr<asset> find(const std::string& name)
+        {
+            auto now = std::chrono::steady_clock::now();
+            std::shared_ptr<asset> cached;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = assets_.find(name);
+                if (it != assets_.end())
+                {
+                    cached = it->second;
+                    lru_.splice(lru_.begin(), lru_, cached->lru);
+                    if (now - cached->checked < revalidate_interval_)
+                        return cached;
+                }
+            }
+
+            std::string path = directory_ + name;
+            variant identity;
+            if (!stat_file(path, identity))
+            {
+                if (cached)
+                    erase(name, cached);
+                return nullptr;
+            }
+            if (cached && cached->identity.size == identity.size && cached->identity.mtime == identity.mtime)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                cached->checked = now;
+                return cached;
+            }
+
+            auto a = load(path, std::move(identity));
+            a->checked = now;
+            insert(name, a);
+            return a;
+        }
+
+        std::shared_ptr<asset> load(const std::string& path, variant identity)
+        {
+            auto a = std::make_shared<asset>();
+            a->identity = std::move(identity);
+            a->etag = make_etag(a->identity);
+            a->last_modified = http_date(a->identity.mtime);
+            a->content_type = mime_type(path);
+
+            // variants older than the file itself are stale
+            if (stat_file(path + ".br", a->brotli) && a->brotli.mtime < a->identity.mtime)
+                a->brotli = variant();
+            if (stat_file(path + ".gz", a->gzip) && a->gzip.mtime < a->identity.mtime)
+                a->gzip = variant();
+
+            a->cost = sizeof(asset) + path.size();
+            for(variant* v : {&a->identity, &a->gzip, &a->brotli})
+            {
+                if (v->exists && v->size <= max_cached_file_size_)
+                {
+                    v->content = read_file(v->path);
+                    if (v->content)
+                        a->cost += v->content->size();
+                }
+            }
+#ifdef CROW_ENABLE_COMPRESSION
+            if (!a->gzip.exists && a->identity.content && a->identity.size >= compression_options().min_size &&
+                !compression::is_compressed_type(a->content_type))
+            {
+                auto gzip = std::make_shared<std::string>();
+                if (compression::compress(*a->identity.content, compression::GZIP, 9, *gzip) && gzip->size() < a->identity.size)
+                {
+                    a->gzip.exists = true;
+                    a->gzip.size = gzip->size();
+                    a->gzip.mtime = a->identity.mtime;
+                    a->gzip.content = std::move(gzip);
+                    a->cost += a->gzip.size;
+                }
+            }
+#endif
+            return a;
+        }
+
+        void insert(const std::string& name, const std::shared_ptr<asset>& a)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = assets_.find(name);
+            if (it != assets_.end())
+            {
+                cache_size_ -= it->second->cost;
+                lru_.erase(it->second->lru);
+                assets_.erase(it);
+            }
+            if (a->cost > max_cache_size_)
+                return;
+            lru_.push_front(name);
+            a->lru = lru_.begin();
+            assets_.emplace(name, a);
+            cache_size_ += a->cost;
+            evict();
+        }
+
+        void erase(const std::string& name, const std::shared_ptr<asset>& a)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = assets_.find(name);
+            if (it == assets_.end() || it->second != a)
+                return;
+            cache_size_ -= a->cost;
+            lru_.erase(a->lru);
+            assets_.erase(it);
+        }
+
+        // drops the least recently used assets; mutex_ is held
+        void evict()
+        {
+            while(cache_size_ > max_cache_size_ && !lru_.empty())
+            {
+                auto it = assets_.find(lru_.back());
+                cache_size_ -= it->second->cost;
+                assets_.erase(it);
+                lru_.pop_back();
+            }
+        }
+
+        static bool not_modified(const request& req, const asset& a)
+        {
+            string_view if_none_match = req.get_header_view(known_header::if_none_match);
+            if (!if_none_match.empty())
+                return if_none_match == "*" || if_none_match.find(a.etag) != string_view::npos;
+            return req.get_header_view(known_header::if_modified_since) == a.last_modified;
+        }
+
+        // percent-decodes `path'; false if it would leave the directory
+        static bool decode_path(const std::string& path, std::string& out)
+        {
+            out.clear();
+            for(size_t i = 0; i < path.size(); i++)
+            {
+                char c = path[i];
+                if (c == '%' && i + 2 < path.size() && isxdigit((unsigned char)path[i+1]) && isxdigit((unsigned char)path[i+2]))
+                {
+                    c = (char)std::stoi(path.substr(i+1, 2), nullptr, 16);
+                    i += 2;
+                }
+                if (c == '\0' || c == '\\')
+                    return false;
+                out += c;
+            }
+            if (out.empty() || out.back() == '/')
+                return false;
+            // no empty, `.' or `..' segments
+            size_t begin = 0;
+            while(begin <= out.size())
+            {
+                size_t end = out.find('/', begin);
+                if (end == std::string::npos)
+                    end = out.size();
+                size_t length = end - begin;
+                if (length == 0 || (out[begin] == '.' && (length == 1 || (length == 2 && out[begin+1] == '.'))))
+                    return false;
+                begin = end + 1;
+            }
+            return true;
+        }
+
+        static bool stat_file(const std::string& path, variant& v)
+        {
+            struct stat st;
+            if (::stat(path.c_str(), &st) != 0 || (st.st_mode & S_IFMT) != S_IFREG)
+                return false;
+            v.exists = true;
+            v.path = path;
+            v.size = st.st_size;
+            v.mtime = st.st_mtime;
+            return true;
+        }
+
+        static std::shared_ptr<const std::string> read_file(const std::string& path)
+        {
+            std::ifstream file(path, std::ios::binary);
+            if (!file)
+                return nullptr;
+            std::ostringstream content;
+            content << file.rdbuf();
+            return std::make_shared<const std::string>(content.str());
+        }
+
+        static std::string make_etag(const variant& v)
+        {
+            std::ostringstream etag;
+            etag << '"' << std::hex << (std::uint64_t)v.mtime << '-' << v.size << '"';
+            return etag.str();
+        }
+
+        static std::string http_date(time_t t)
+        {
+            tm my_tm;
+#if defined(_MSC_VER) or defined(__MINGW32__)
+            gmtime_s(&my_tm, &t);
+#else
+            gmtime_r(&t, &my_tm);
+#endif
+            char buf[64];
+            size_t size = strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &my_tm);
+            return std::string(buf, size);
+        }
+
+        static std::string mime_type(const std::string& path)
+        {
+            static const std::unordered_map<std::string, std::string> types{
+                {"html", "text/html; charset=utf-8"},
+                {"htm", "text/html; charset=utf-8"},
+                {"css", "text/css; charset=utf-8"},
+                {"js", "application/javascript; charset=utf-8"},
+                {"mjs", "application/javascript; charset=utf-8"},
+                {"json", "application/json"},
+                {"map", "application/json"},
+                {"txt", "text/plain; charset=utf-8"},
+                {"xml", "application/xml"},
+                {"svg", "image/svg+xml"},
+                {"png", "image/png"},
+                {"jpg", "image/jpeg"},
+                {"jpeg", "image/jpeg"},
+                {"gif", "image/gif"},
+                {"webp", "image/webp"},
+                {"ico", "image/x-icon"},
+                {"wasm", "application/wasm"},
+                {"woff", "font/woff"},
+                {"woff2", "font/woff2"},
+                {"ttf", "font/ttf"},
+                {"pdf", "application/pdf"},
+                {"mp3", "audio/mpeg"},
+                {"mp4", "video/mp4"},
+                {"webm", "video/webm"},
+            };
+            size_t dot = path.rfind('.');
+            if (dot != std::string::npos && path.find('/', dot) == std::string::npos)
+            {
+                std::string ext = path.substr(dot + 1);
+                for(auto& c : ext)
+                    c = tolower((unsigned char)c);
+                auto it = types.find(ext);
+                if (it != types.end())
+                    return it->second;
+            }
+            return "application/octet-stream";
+        }
+
+        std::string directory_;
+        std::string url_prefix_{"/static/"};
+        std::size_t max_cache_size_{64*1024*1024};
+        std::size_t max_cached_file_size_{1024*1024};
+        std::chrono::milliseconds revalidate_interval_{1000};
+
+        std::mutex mutex_;
+        // most recently used first
+        std::list<std::string> lru_;
+        std::unordered_map<std::string, std::shared_ptr<asset>> assets_;
+        std::size_t cache_size_{};
+    };
+}
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "crow/logging.h"
+
+namespace crow
+{
+    namespace detail
+    {
+        // hierarchical timing wheel (as in the Linux kernel's timers): a wheel of
+        // 256 one-tick slots and three coarser wheels of 64 slots each, whose
+        // timers are moved down as their time comes. adding and cancelling a
+        // timer is O(1), firing is O(1) per timer and a tick without timers is
+        // skipped entirely. timers fire at the tick they are due, never
+        // early; those beyond 2^26 ticks wait in the coarsest wheel meanwhile.
+        class timer_wheel
+        {
+        public:
+            using clock = std::chrono::steady_clock;
+            using duration = std::chrono::milliseconds;
+
+            // identifies a pending timer; stale keys are ignored by cancel()
+            struct key
+            {
+                timer_wheel* wheel{};
+                std::uint32_t index{};
+                std::uint32_t generation{};
+            };
+
+            explicit timer_wheel(duration resolution = duration(10))
+                : resolution_(resolution.count() > 0 ? resolution : duration(1)), start_(clock::now())
+            {
+                for(auto& head : heads_)
+                    head = nil;
+            }
+
+            timer_wheel(const timer_wheel&) = delete;
+            timer_wheel& operator = (const timer_wheel&) = delete;
+
+            // calls `f' on the io_service's thread once `d' has passed
+            key add(duration d, std::function<void()> f)
+            {
+                std::uint32_t index;
+                if (free_ != nil)
+                {
+                    index = free_;
+                    free_ = nodes_[index].next;
+                }
+                else
+                {
+                    index = nodes_.size();
+                    nodes_.emplace_back();
+                }
+                auto now = clock::now();
+                // an empty wheel need not catch up with the time it was idle
+                if (!size_)
+                    current_ = std::max(current_, ticks(now, false));
+                node& n = nodes_[index];
+                n.f = std::move(f);
+                n.expires = ticks(now + d, true);
+                link(index);
+                size_++;
+
+                if (n.expires < wakeup_)
+                    schedule(n.expires);
+                return {this, index, n.generation};
+            }
+
+            // cancels the timer of `k', if it is pending, and clears `k'
+            void cancel(key& k)
+            {
+                auto self = k.wheel;
+                k.wheel = nullptr;
+                if (!self || k.index >= self->nodes_.size())
+                    return;
+                node& n = self->nodes_[k.index];
+                if (n.generation != k.generation || n.slot == nil)
+                    return;
+                self->unlink(k.index);
+                self->release(k.index);
+                self->size_--;
+            }
+
+            // number of pending timers
+            std::size_t size() const
+            {
+                return size_;
+            }
+
+            // runs the timers that are due
+            void process()
+            {
+                std::uint64_t now = ticks(clock::now(), false);
+                if (!size_)
+                    current_ = now + 1;
+                while(current_ <= now)
+                {
+                    std::uint32_t slot = current_ & (root_size-1);
+                    if (!slot)
+                        cascade(0);
+
+                    // callbacks may add and cancel timers; the due ones are
+                    // moved aside first so a timer added for now waits a tick
+                    move_to_firing(slot);
+                    current_++;
+                    while(heads_[firing] != nil)
+                    {
+                        std::uint32_t index = heads_[firing];
+                        unlink(index);
+                        auto f = std::move(nodes_[index].f);
+                        release(index);
+                        size_--;
+                        f();
+                    }
+                }
+                wakeup_ = never;
+                schedule(next_expiry());
+            }
+
+            // process() is then called by a timer on `io_service'
+            void set_io_service(boost::asio::io_service& io_service)
+            {
+                timer_.reset(new boost::asio::steady_timer(io_service));
+                wakeup_ = never;
+                schedule(next_expiry());
+            }
+
+        private:
+            static const std::uint32_t nil = 0xffffffff;
+            static const std::uint32_t root_bits = 8;
+            static const std::uint32_t root_size = 1 << root_bits;
+            static const std::uint32_t level_bits = 6;
+            static const std::uint32_t level_size = 1 << level_bits;
+            static const std::uint32_t levels = 3;
+            static const std::uint64_t max_ticks = (std::uint64_t)1 << (root_bits + levels*level_bits);
+            // the list being fired sits behind the slots
+            static const std::uint32_t firing = root_size + levels*level_size;
+            static const std::uint64_t never = ~(std::uint64_t)0;
+
+            struct node
+            {
+                std::uint32_t prev{nil};
+                std::uint32_t next{nil};
+                // nil when free
+                std::uint32_t slot{nil};
+                std::uint32_t generation{};
+                std::uint64_t expires{};
+                std::function<void()> f;
+            };
+
+            std::uint64_t ticks(clock::time_point t, bool round_up) const
+            {
+                auto d = (t - start_).count();
+                auto r = std::chrono::duration_cast<clock::duration>(resolution_).count();
+                if (d < 0)
+                    return 0;
+                return d / r + (round_up && d % r ? 1 : 0);
+            }
+
+            std::uint32_t slot_for(std::uint64_t& expires) const
+            {
+                if (expires < current_)
+                    expires = current_;
+                // timers beyond the wheels go as far as they reach and are
+                // placed again when that slot is cascaded, until they are in range
+                std::uint64_t target = std::min(expires, current_ + max_ticks - 1);
+                std::uint64_t delta = target - current_;
+                if (delta < root_size)
+                    return target & (root_size-1);
+                for(std::uint32_t level = 0; ; level++)
+                {
+                    std::uint32_t shift = root_bits + (level+1)*level_bits;
+                    if (level == levels-1 || delta < ((std::uint64_t)1 << shift))
+                        return root_size + level*level_size + ((target >> (shift - level_bits)) & (level_size-1));
+                }
+            }
+
+            void link(std::uint32_t index)
+            {
+                node& n = nodes_[index];
+                n.slot = slot_for(n.expires);
+                insert(n.slot, index);
+            }
+
+            void insert(std::uint32_t slot, std::uint32_t index)
+            {
+                node& n = nodes_[index];
+                n.slot = slot;
+                n.prev = nil;
+                n.next = heads_[slot];
+                if (n.next != nil)
+                    nodes_[n.next].prev = index;
+                heads_[slot] = index;
+            }
+
+            void unlink(std::uint32_t index)
+            {
+                node& n = nodes_[index];
+                if (n.prev != nil)
+                    nodes_[n.prev].next = n.next;
+                else
+                    heads_[n.slot] = n.next;
+                if (n.next != nil)
+                    nodes_[n.next].prev = n.prev;
+                n.slot = nil;
+            }
+
+            void release(std::uint32_t index)
+            {
+                node& n = nodes_[index];
+                n.f = nullptr;
+                n.generation++;
+                n.next = free_;
+                free_ = index;
+            }
+
+            // redistributes the slot of `level' that is now due into finer wheels
+            void cascade(std::uint32_t level)
+            {
+                std::uint32_t shift = root_bits + level*level_bits;
+                std::uint32_t slot = (current_ >> shift) & (level_size-1);
+                if (!slot && level+1 < levels)
+                    cascade(level+1);
+                std::uint32_t head = root_size + level*level_size + slot;
+                std::uint32_t index = heads_[head];
+                heads_[head] = nil;
+                while(index != nil)
+                {
+                    std::uint32_t next = nodes_[index].next;
+                    link(index);
+                    index = next;
+                }
+            }
+
+            void move_to_firing(std::uint32_t slot)
+            {
+                heads_[firing] = heads_[slot];
+                heads_[slot] = nil;
+                for(std::uint32_t index = heads_[firing]; index != nil; index = nodes_[index].next)
+                    nodes_[index].slot = firing;
+            }
+
+            // the first tick at which process() may have something to do
+            std::uint64_t next_expiry() const
+            {
+                if (!size_)
+                    return never;
+                // the next cascade may bring timers into the finest wheel
+                std::uint64_t boundary = (current_ | (root_size-1)) + 1;
+                for(std::uint64_t t = current_; t < boundary; t++)
+                {
+                    if (heads_[t & (root_size-1)] != nil)
+                        return t;
+                }
+                return boundary;
+            }
+
+            void schedule(std::uint64_t tick)
+            {
+                if (!timer_ || tick == never)
+                    return;
+                wakeup_ = tick;
+                timer_->expires_at(start_ + resolution_ * (duration::rep)tick);
+                timer_->async_wait([this](const boost::system::error_code& ec)
+                    {
+                        // also called when a timer is added for an earlier tick
+                        if (ec)
+                            return;
+                        process();
+                    });
+            }
+
+            duration resolution_;
+            clock::time_point start_;
+            // the next tick to process
+            std::uint64_t current_{};
+            // when timer_ fires next
+            std::uint64_t wakeup_{never};
+            std::size_t size_{};
+
+            std::vector<node> nodes_;
+            std::uint32_t free_{nil};
+            std::uint32_t heads_[firing + 1];
+            std::unique_ptr<boost::asio::steady_timer> timer_;
+        };
+    }
+}
@@ -45,7 +45,7 @@ namespace crow
 					: adaptor_(std::move(adaptor)), open_handler_(std::move(open_handler)), message_handler_(std::move(message_handler)), close_handler_(std::move(close_handler)), error_handler_(std::move(error_handler))
 					, accept_handler_(std::move(accept_handler))
 				{
-					if (!boost::iequals(req.get_header_value("upgrade"), "websocket"))
+					if (!ci_equal(req.get_header_view(known_header::upgrade), "websocket"))
 					{
 						adaptor.close();
 						delete this;
@@ -64,7 +64,7 @@ namespace crow
 
 					// Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==
 					// Sec-WebSocket-Version: 13
-                    std::string magic = req.get_header_value("Sec-WebSocket-Key") +  "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+                    std::string magic = req.get_header_view("Sec-WebSocket-Key").to_string() +  "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
                     sha1::SHA1 s;
                     s.processBytes(magic.data(), magic.size());
                     uint8_t digest[20];
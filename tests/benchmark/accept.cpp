@@ -0,0 +1,78 @@
+// new connections per second, each carrying one request, with one acceptor
+// thread and with an SO_REUSEPORT acceptor per worker (Crow::reuse_port),
+// for several values of concurrency()
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "crow.h"
+
+using namespace std;
+namespace asio = boost::asio;
+
+static const uint16_t port = 45470;
+
+static double run(uint16_t threads, bool reuse_port, unsigned clients)
+{
+    crow::SimpleApp app;
+    CROW_ROUTE(app, "/")([]{ return "ok"; });
+    app.bindaddr("127.0.0.1").port(port).concurrency(threads);
+    if (reuse_port)
+        app.reuse_port();
+    auto server = async(launch::async, [&]{ app.run(); });
+    app.wait_for_server_start();
+
+    const string request = "GET / HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    atomic<bool> done{false};
+    atomic<size_t> connections{0};
+    vector<future<void>> v;
+    auto start = chrono::steady_clock::now();
+    for(unsigned i = 0; i < clients; i ++)
+    {
+        v.push_back(async(launch::async, [&]
+        {
+            asio::io_service is;
+            char buf[512];
+            while(!done)
+            {
+                asio::ip::tcp::socket c(is);
+                boost::system::error_code ec;
+                c.connect(asio::ip::tcp::endpoint(asio::ip::address::from_string("127.0.0.1"), port), ec);
+                if (ec)
+                    continue;
+                c.send(asio::buffer(request), 0, ec);
+                while(!ec)
+                    c.read_some(asio::buffer(buf), ec);
+                connections ++;
+            }
+        }));
+    }
+    this_thread::sleep_for(chrono::seconds(2));
+    done = true;
+    for(auto& f : v)
+        f.get();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    app.stop();
+    server.get();
+    return connections / seconds;
+}
+
+int main()
+{
+    crow::logger::setLogLevel(crow::LogLevel::Warning);
+    unsigned cores = max(1u, thread::hardware_concurrency());
+    // enough clients to keep the server busy
+    unsigned clients = max(4u, cores * 2);
+    printf("%u cores, %u clients\n", cores, clients);
+    for(uint16_t threads = 1; threads <= max(4u, cores); threads *= 2)
+    {
+        double single = run(threads, false, clients);
+        double per_worker = run(threads, true, clients);
+        printf("concurrency %2u: one acceptor %.0f, reuse_port %.0f accepts/s\n", threads, single, per_worker);
+    }
+}
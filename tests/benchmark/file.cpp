@@ -0,0 +1,87 @@
+// file responses of 1 KB to 100 MB over loopback: sent from the file with
+// res.set_file() (sendfile), and read into res.body first
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <sstream>
+#include <string>
+
+#include "crow.h"
+
+using namespace std;
+namespace asio = boost::asio;
+
+static const uint16_t port = 45471;
+
+static string file_name(size_t size)
+{
+    return "crow_benchmark_" + to_string(size) + ".bin";
+}
+
+// requests per second for `url' on one keep-alive connection
+static double run(const string& url, size_t size)
+{
+    static char buf[1024*1024];
+    asio::io_service is;
+    asio::ip::tcp::socket c(is);
+    c.connect(asio::ip::tcp::endpoint(asio::ip::address::from_string("127.0.0.1"), port));
+    const string request = "GET " + url + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    size_t requests = 0;
+    auto start = chrono::steady_clock::now();
+    while(chrono::steady_clock::now() - start < chrono::seconds(2) || requests < 5)
+    {
+        c.send(asio::buffer(request));
+        // the header, then `size' bytes of body
+        string header;
+        size_t body = 0;
+        while(true)
+        {
+            size_t n = c.receive(asio::buffer(buf));
+            header.append(buf, n);
+            size_t end = header.find("\r\n\r\n");
+            if (end != string::npos)
+            {
+                body = header.size() - end - 4;
+                break;
+            }
+        }
+        while(body < size)
+            body += c.receive(asio::buffer(buf));
+        requests ++;
+    }
+    return requests / chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main()
+{
+    crow::SimpleApp app;
+    app.loglevel(crow::LogLevel::Warning);
+    CROW_ROUTE(app, "/file/<uint>")([](const crow::request&, crow::response& res, unsigned long long size){
+        res.set_file(file_name(size));
+        res.end();
+    });
+    CROW_ROUTE(app, "/string/<uint>")([](const crow::request&, crow::response& res, unsigned long long size){
+        ifstream file(file_name(size), ios::binary);
+        ostringstream body;
+        body << file.rdbuf();
+        res.body = body.str();
+        res.end();
+    });
+    auto server = async(launch::async, [&]{ app.bindaddr("127.0.0.1").port(port).run(); });
+    app.wait_for_server_start();
+
+    const size_t sizes[] = {1024, 64*1024, 1024*1024, 16*1024*1024, 100*1024*1024};
+    for(size_t size : sizes)
+    {
+        ofstream(file_name(size), ios::binary) << string(size, 'x');
+        double file = run("/file/" + to_string(size), size);
+        double body = run("/string/" + to_string(size), size);
+        printf("%9zu bytes: set_file %8.0f req/s %6.2f GB/s, body %8.0f req/s %6.2f GB/s\n",
+            size, file, file * size / 1e9, body, body * size / 1e9);
+        remove(file_name(size).c_str());
+    }
+
+    app.stop();
+    server.get();
+}
@@ -0,0 +1,100 @@
+// latency of a trivial route on a worker whose other requests block for
+// 20 ms each, with the blocking handler run on the worker and offloaded
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "crow.h"
+
+using namespace std;
+namespace asio = boost::asio;
+
+static const uint16_t port = 45472;
+
+static void get(asio::ip::tcp::socket& c, const string& request)
+{
+    static thread_local char buf[2048];
+    c.send(asio::buffer(request));
+    string response;
+    while(response.find("\r\n\r\n") == string::npos)
+        response.append(buf, c.receive(asio::buffer(buf)));
+}
+
+static string request_for(const string& url)
+{
+    return "GET " + url + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+}
+
+// `blockers' clients keep requesting `blocking_url' while one measures /ping
+static void run(const string& blocking_url, unsigned blockers)
+{
+    atomic<bool> done{false};
+    vector<future<void>> v;
+    for(unsigned i = 0; i < blockers; i ++)
+    {
+        v.push_back(async(launch::async, [&]
+        {
+            asio::io_service is;
+            asio::ip::tcp::socket c(is);
+            c.connect(asio::ip::tcp::endpoint(asio::ip::address::from_string("127.0.0.1"), port));
+            while(!done)
+                get(c, request_for(blocking_url));
+        }));
+    }
+    this_thread::sleep_for(chrono::milliseconds(100));
+
+    asio::io_service is;
+    asio::ip::tcp::socket c(is);
+    c.connect(asio::ip::tcp::endpoint(asio::ip::address::from_string("127.0.0.1"), port));
+    vector<double> latencies;
+    auto start = chrono::steady_clock::now();
+    while(chrono::steady_clock::now() - start < chrono::seconds(2))
+    {
+        auto t = chrono::steady_clock::now();
+        get(c, request_for("/ping"));
+        latencies.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - t).count());
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    done = true;
+    for(auto& f : v)
+        f.get();
+
+    sort(latencies.begin(), latencies.end());
+    auto at = [&](double q){ return latencies[min(latencies.size() - 1, (size_t)(q * latencies.size()))]; };
+    printf("%-10s %u blocking clients: /ping p50 %7.3f ms, p99 %7.3f ms, max %7.3f ms\n",
+        blocking_url.c_str(), blockers, at(0.5), at(0.99), latencies.back());
+}
+
+int main()
+{
+    crow::SimpleApp app;
+    app.loglevel(crow::LogLevel::Warning);
+    // one worker, so every connection shares its event loop
+    app.concurrency(1).offload_threads(8);
+    auto blocking = []
+    {
+        // a slow database call
+        this_thread::sleep_for(chrono::milliseconds(20));
+        return "done";
+    };
+    CROW_ROUTE(app, "/inline")(blocking);
+    CROW_ROUTE(app, "/offload").offload()(blocking);
+    CROW_ROUTE(app, "/ping")([]{ return "pong"; });
+    auto server = async(launch::async, [&]{ app.bindaddr("127.0.0.1").port(port).run(); });
+    app.wait_for_server_start();
+
+    run("/inline", 0);
+    for(unsigned blockers : {1, 4})
+    {
+        run("/inline", blockers);
+        run("/offload", blockers);
+    }
+
+    app.stop();
+    server.get();
+}
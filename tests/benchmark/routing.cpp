@@ -0,0 +1,73 @@
+// lookups per second of a routing trie with a few hundred API style routes
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "crow.h"
+
+using namespace std;
+
+static void run(const crow::Trie& trie, const vector<string>& urls, const char* label)
+{
+    size_t lookups = 0, hits = 0;
+    auto start = chrono::steady_clock::now();
+    while(chrono::steady_clock::now() - start < chrono::seconds(2))
+    {
+        for(int i = 0; i < 100; i ++)
+        {
+            for(auto& url : urls)
+            {
+                hits += trie.find(url).first != 0;
+                lookups ++;
+            }
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printf("%s (%zu urls): %.2fM lookups/s (%zu hits)\n", label, urls.size(), lookups / seconds / 1e6, hits);
+}
+
+int main()
+{
+    const char* resources[] = {
+        "users", "posts", "comments", "orders", "products", "invoices", "customers",
+        "sessions", "teams", "projects", "issues", "builds", "tags", "files",
+        "events", "reports", "alerts", "metrics", "accounts", "payments",
+    };
+
+    crow::Trie trie;
+    // one url for each route, and the static ones alone
+    vector<string> urls, static_urls;
+    unsigned rule_index = 2;
+    auto add = [&](const string& rule, const string& url, bool is_static)
+    {
+        trie.add(rule, rule_index++);
+        urls.push_back(url);
+        if (is_static)
+            static_urls.push_back(url);
+    };
+    for(auto resource : resources)
+    {
+        for(auto version : {"v1", "v2"})
+        {
+            string base = string("/api/") + version + "/" + resource;
+            add(base, base, true);
+            add(base + "/<int>", base + "/123", false);
+            add(base + "/<int>/history", base + "/123/history", false);
+            add(base + "/<int>/settings", base + "/77/settings", false);
+            add(base + "/search", base + "/search", true);
+            add(base + "/<string>/summary", base + "/abc/summary", false);
+            add(base + "/export/<string>", base + "/export/csv", false);
+        }
+    }
+    add("/static/<path>", "/static/css/site.css", false);
+    add("/", "/", true);
+    add("/health", "/health", true);
+    // and a miss
+    urls.push_back("/api/v1/nothing/here");
+    trie.validate();
+
+    printf("%u routes\n", rule_index - 2);
+    run(trie, urls, "all");
+    run(trie, static_urls, "static");
+}